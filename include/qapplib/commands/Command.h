@@ -20,6 +20,7 @@ along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <iostream>
+#include <memory_resource>
 
 namespace qapp
 {
@@ -27,11 +28,12 @@ namespace qapp
 
 	struct SCommandCreationContext
 	{
-		SCommandCreationContext(IEditor& editor, std::ostream& data)
-			: m_Editor(editor), m_Data(data) {}
+		SCommandCreationContext(IEditor& editor, std::ostream& data, std::pmr::memory_resource& memory)
+			: m_Editor(editor), m_Data(data), m_Memory(memory) {}
 
 		IEditor& m_Editor;
 		std::ostream& m_Data;
+		std::pmr::memory_resource& m_Memory;  // Lives as long as the created command, e.g. for std::pmr containers
 		bool m_Incomplete = false;
 	};
 
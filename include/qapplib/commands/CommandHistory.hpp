@@ -24,6 +24,7 @@ along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 #include <memory>
 #include <optional>
 
+#include <qapplib/utils/MemoryResource.h>
 #include <qapplib/utils/PageBufferStream.h>
 #include <qapplib/utils/PageStackAllocator.h>
 #include "Command.h"
@@ -39,6 +40,10 @@ namespace qapp
 		CCommandHistory(IEditor& editor, CPagePool& page_pool);
 		~CCommandHistory();
 
+		// Compresses pages of command data not accessed during the last idle_operations data buffer operations,
+		// see page_buffer::set_compression. Off (0) by default.
+		void SetDataCompression(size_t idle_operations);
+
 		void Clear();
 
 		template<class TCommand, typename... TArgs>
@@ -65,10 +70,9 @@ namespace qapp
 		void DirtyChanged(bool dirty);
 
 	private:
+		// Commands and their SCommand live in m_Allocator, which destroys them when restored past them or cleared
 		struct SCommand
 		{
-			~SCommand();
-
 			ICommand* m_Command = nullptr;
 			SCommand* m_Next = nullptr;
 			page_stack_allocator::state_t m_AllocatorState = 0;
@@ -80,9 +84,8 @@ namespace qapp
 
 		void Undo(SCommand& cmd);
 
-		void FreeCommandList(SCommand* front);
-
-		void FreeCommand(SCommand& cmd);
+		// Resets the clean point if it is one of the commands about to be freed
+		void ForgetCleanPoint(const SCommand* front);
 
 		void FreeAll();
 
@@ -91,6 +94,7 @@ namespace qapp
 		IEditor&    m_Editor;
 		page_buffer m_DataBuffer;
 		page_stack_allocator m_Allocator;
+		page_stack_resource m_Memory;
 		size_t      m_DataBufferPos = 0;
 		SCommand*   m_UndoStack = nullptr;
 		SCommand*   m_RedoStack = nullptr;
@@ -114,12 +118,20 @@ namespace qapp
 	{
 		ClearRedoStack();
 		const auto allocator_state = m_Allocator.state();
-		page_buffer_ostream data(m_DataBuffer, m_DataBufferPos);
-		SCommandCreationContext ctx_create(m_Editor, data);
-		auto cmd_optional = lambda(ctx_create);
+		bool incomplete = false;
+		auto cmd_optional = [&]()
+		{
+			// The stream publishes its data when destroyed, so it must be gone before the data is discarded below
+			page_buffer_ostream data(m_DataBuffer, m_DataBufferPos);
+			SCommandCreationContext ctx_create(m_Editor, data, m_Memory);
+			auto cmd = lambda(ctx_create);
+			incomplete = ctx_create.m_Incomplete;
+			return cmd;
+		}();
 		if (!cmd_optional.has_value())
 		{
 			m_DataBuffer.resize(m_DataBufferPos);
+			m_Allocator.restore(allocator_state);
 			return false;
 		}
 		typedef typename decltype(cmd_optional)::value_type command_type;
@@ -127,7 +139,7 @@ namespace qapp
 		cmd->m_Command = m_Allocator.New<command_type>(std::move(cmd_optional.value()));
 		cmd->m_AllocatorState = allocator_state;
 		cmd->m_DataSize = m_DataBuffer.size() - m_DataBufferPos;
-		cmd->m_Incomplete = ctx_create.m_Incomplete;
+		cmd->m_Incomplete = incomplete;
 		Do(*cmd);
 		cmd->m_Next = m_UndoStack;
 		m_UndoStack = cmd;
@@ -20,6 +20,11 @@ along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <bit>
+#include <cstdint>
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
 
 namespace qapp
 {
@@ -29,6 +34,20 @@ namespace qapp
 		return (val + align_mask) & ~align_mask;
 	}
 
+	// High 64 bits of the 128 bit product of a and b
+	inline uint64_t mul_hi64(uint64_t a, uint64_t b)
+	{
+	#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+		return __umulh(a, b);
+	#elif defined(__SIZEOF_INT128__)
+		return (uint64_t)(((unsigned __int128)a * b) >> 64);
+	#else
+		const uint64_t a_lo = (uint32_t)a, a_hi = a >> 32, b_lo = (uint32_t)b, b_hi = b >> 32;
+		const uint64_t mid = (a_lo * b_lo >> 32) + (uint32_t)(a_hi * b_lo) + a_lo * b_hi;
+		return a_hi * b_hi + (a_hi * b_lo >> 32) + (mid >> 32);
+	#endif
+	}
+
 	template <typename T, class TLambda>
 	inline static void for_each_set_bit(T bits, TLambda&& fn)
 	{
@@ -0,0 +1,116 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace qapp
+{
+	// Byte search kernels using AVX2 when the CPU has it, SSE2 on other x86 CPUs and plain C++ elsewhere. They
+	// return nullptr when there is no match.
+
+	const void* find_byte(const void* data, size_t size, uint8_t byte);
+
+	const void* find_pattern(const void* data, size_t size, const void* pattern, size_t pattern_size);
+
+	size_t count_byte(const void* data, size_t size, uint8_t byte);
+
+	// The same over the segments of a page_buffer, page_buffer_snapshot, page_rope or shared_page_buffer_view from
+	// offset on, matches may straddle segments. Return buffer offsets, or SIZE_MAX when there is no match.
+
+	template <class TBuffer>
+	size_t find_byte_in(const TBuffer& buffer, size_t offset, uint8_t byte)
+	{
+		size_t ret = SIZE_MAX;
+		size_t pos = offset;
+		buffer.for_each_segment(offset, SIZE_MAX, [&](const void* data, size_t size)
+			{
+				if (auto* p = find_byte(data, size, byte))
+				{
+					ret = pos + ((const char*)p - (const char*)data);
+					return false;
+				}
+				pos += size;
+				return true;
+			});
+		return ret;
+	}
+
+	template <class TBuffer>
+	size_t find_pattern_in(const TBuffer& buffer, size_t offset, const void* pattern, size_t pattern_size)
+	{
+		if (pattern_size <= 1)
+			return pattern_size ? find_byte_in(buffer, offset, *(const uint8_t*)pattern) : (offset <= buffer.size() ? offset : SIZE_MAX);
+
+		// Matches straddling segments are looked for in a window of the last pattern_size - 1 bytes before each
+		// segment followed by the first pattern_size - 1 bytes of it
+		const auto overlap = pattern_size - 1;
+		std::vector<char> window;
+		size_t ret = SIZE_MAX;
+		size_t pos = offset;
+		buffer.for_each_segment(offset, SIZE_MAX, [&](const void* data, size_t size)
+			{
+				const auto carry_size = window.size();
+				if (carry_size)
+				{
+					window.insert(window.end(), (const char*)data, (const char*)data + std::min(size, overlap));
+					auto* p = (const char*)find_pattern(window.data(), window.size(), pattern, pattern_size);
+					if (p && (size_t)(p - window.data()) < carry_size)
+					{
+						ret = pos - carry_size + (p - window.data());
+						return false;
+					}
+					window.resize(carry_size);
+				}
+				if (auto* p = find_pattern(data, size, pattern, pattern_size))
+				{
+					ret = pos + ((const char*)p - (const char*)data);
+					return false;
+				}
+				pos += size;
+
+				// Keep the last overlap bytes for the next segment
+				if (size >= overlap)
+					window.assign((const char*)data + size - overlap, (const char*)data + size);
+				else
+				{
+					window.insert(window.end(), (const char*)data, (const char*)data + size);
+					if (window.size() > overlap)
+						window.erase(window.begin(), window.end() - overlap);
+				}
+				return true;
+			});
+		return ret;
+	}
+
+	template <class TBuffer>
+	size_t count_byte_in(const TBuffer& buffer, size_t offset, size_t size, uint8_t byte)
+	{
+		size_t count = 0;
+		buffer.for_each_segment(offset, size, [&](const void* data, size_t size)
+			{
+				count += count_byte(data, size, byte);
+			});
+		return count;
+	}
+}
\ No newline at end of file
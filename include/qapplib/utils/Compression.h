@@ -0,0 +1,34 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+namespace qapp
+{
+	// Fast LZ77 block codec in the spirit of LZ4, for data that is compressed and decompressed in memory by the
+	// same build. There is no header, the caller keeps track of the sizes.
+
+	// Returns the compressed size, or 0 if the result would not fit in dst_capacity bytes
+	size_t lz_compress(const void* src, size_t src_size, void* dst, size_t dst_capacity);
+
+	// Returns false if src is not a valid block or decompresses to more than dst_capacity bytes
+	bool lz_decompress(const void* src, size_t src_size, void* dst, size_t dst_capacity, size_t& ret_size);
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifdef __linux__
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "PageAllocator.h"
+
+namespace qapp
+{
+	// Page allocator backing pages with a sparse, unlinked temporary file mapped with MAP_SHARED. The kernel can
+	// write cold pages back to the file and drop them from memory instead of running out of memory, so it suits
+	// pools holding large and mostly cold data such as undo history. With an empty directory the file is an
+	// anonymous memfd instead, which is backed by swap rather than by a disk file. Thread safe.
+	class CFilePageAllocator : public IPageAllocator
+	{
+	public:
+		CFilePageAllocator(size_t page_size, const std::string& directory = "/var/tmp", size_t region_size = (size_t)1 << 30);
+		~CFilePageAllocator();
+
+		size_t PageSize() const override { return m_PageSize; }
+		void*  AllocPage() override;
+		void   FreePage(void* page) override;
+		void   DecommitPage(void* page) override;
+
+		inline int FileDescriptor() const { return m_Fd; }
+
+		// Offset in the backing file of a page allocated from this allocator
+		uint64_t FileOffset(const void* page) const;
+
+	protected:
+		struct SRegion
+		{
+			char*    m_Ptr = nullptr;
+			uint64_t m_FileOffset = 0;
+		};
+
+		void MapRegion();
+
+		void PunchHole(uint64_t file_offset, size_t size);
+
+		const size_t m_PageSize;
+		const size_t m_RegionSize;
+		int          m_Fd = -1;
+		mutable std::mutex   m_Mutex;
+		std::vector<SRegion> m_Regions;    // Sorted by file offset, each region maps m_RegionSize bytes of the file
+		std::vector<void*>   m_FreePages;
+		size_t               m_CarvedSize = 0;  // Bytes of the last region handed out at least once
+	};
+
+	template <size_t TPageSize>
+	class TFilePageAllocator : public CFilePageAllocator
+	{
+	public:
+		TFilePageAllocator(const std::string& directory = "/var/tmp", size_t region_size = (size_t)1 << 30)
+			: CFilePageAllocator(TPageSize, directory, region_size) {}
+	};
+}
+
+#endif
\ No newline at end of file
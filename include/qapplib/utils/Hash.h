@@ -0,0 +1,75 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace qapp
+{
+	// Fast non-cryptographic hashing, XXH64 compatible. hash128 runs two XXH64 with different seeds, so it costs
+	// twice as much.
+
+	struct hash128_t
+	{
+		uint64_t m_Low = 0;
+		uint64_t m_High = 0;
+
+		inline bool operator==(const hash128_t& other) const { return m_Low == other.m_Low && m_High == other.m_High; }
+		inline bool operator!=(const hash128_t& other) const { return !(*this == other); }
+	};
+
+	uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+
+	hash128_t hash128(const void* data, size_t size, uint64_t seed = 0);
+
+	// hash64 of data given in parts
+	class hasher64
+	{
+	public:
+		hasher64(uint64_t seed = 0);
+
+		void update(const void* data, size_t size);
+
+		uint64_t digest() const;
+
+	private:
+		uint64_t m_Lanes[4];
+		uint64_t m_Seed;
+		uint64_t m_TotalSize = 0;
+		unsigned char m_Stripe[32];  // Bytes not making up a full stripe yet
+		size_t m_StripeSize = 0;
+	};
+
+	// hash128 of data given in parts
+	class hasher128
+	{
+	public:
+		hasher128(uint64_t seed = 0);
+
+		void update(const void* data, size_t size);
+
+		hash128_t digest() const;
+
+	private:
+		hasher64 m_Low;
+		hasher64 m_High;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifdef __linux__
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace qapp
+{
+	// Watches Linux pressure stall information (PSI) and reports when tasks stall on memory for at least stall_us
+	// within any window of window_us. Use "/proc/pressure/memory" for the whole system or the memory.pressure file
+	// of a cgroup v2 for a container. Without CAP_SYS_RESOURCE the kernel only accepts windows that are multiples
+	// of 2 seconds. Either poll FileDescriptor() for POLLPRI (e.g. with a QSocketNotifier of type Exception), or
+	// Start() a thread that invokes a callback. The callback runs on that thread, so CPagePool::NotifyPressure is
+	// only safe for pools in EThreading::Concurrent mode.
+	class CMemoryPressureMonitor
+	{
+	public:
+		CMemoryPressureMonitor(const std::string& pressure_path = "/proc/pressure/memory", unsigned stall_us = 150000, unsigned window_us = 2000000, bool full_stall = false);
+		~CMemoryPressureMonitor();
+
+		inline int FileDescriptor() const { return m_Fd; }
+
+		// Waits for the trigger to fire, returns false on timeout (timeout_ms < 0 waits indefinitely)
+		bool Wait(int timeout_ms);
+
+		// Invokes on_pressure from a new thread each time the trigger fires. An exception thrown by the callback or
+		// by waiting ends the thread and is rethrown by Stop.
+		void Start(std::function<void()> on_pressure);
+
+		void Stop();
+
+	private:
+		void StopThread();
+
+		int m_Fd = -1;
+		int m_StopFd = -1;
+		std::thread m_Thread;
+		std::atomic<bool> m_Stopping = false;
+		std::exception_ptr m_ThreadError;
+	};
+}
+
+#endif
\ No newline at end of file
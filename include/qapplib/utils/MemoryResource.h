@@ -0,0 +1,94 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <memory_resource>
+#include "PageSlab.h"
+#include "PageStackAllocator.h"
+
+namespace qapp
+{
+	// Monotonic std::pmr::memory_resource on a page_stack_allocator. Deallocation is a no-op, memory is reclaimed
+	// when the allocator is restored to an earlier state or cleared.
+	class page_stack_resource : public std::pmr::memory_resource
+	{
+	public:
+		page_stack_resource(page_stack_allocator_base& allocator) : m_Allocator(allocator) {}
+
+		inline page_stack_allocator_base& allocator() const { return m_Allocator; }
+
+	protected:
+		void* do_allocate(size_t bytes, size_t alignment) override;
+
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+	private:
+		page_stack_allocator_base& m_Allocator;
+	};
+
+	// General purpose std::pmr::memory_resource on a CPagePool. Small blocks are served from one page_slab_base per
+	// power of two size class, blocks up to the max page size get a pool page of their own and larger blocks are
+	// passed to the upstream resource. Not thread safe, like std::pmr::unsynchronized_pool_resource.
+	class page_pool_resource : public std::pmr::memory_resource
+	{
+	public:
+		page_pool_resource(CPagePool& page_pool = CPagePool::DefaultPagePool(), std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+		~page_pool_resource();
+
+		page_pool_resource(const page_pool_resource&) = delete;
+		page_pool_resource& operator=(const page_pool_resource&) = delete;
+
+		// Returns the slab pages to the pool, blocks still allocated from the slabs become invalid
+		void release();
+
+		inline CPagePool& page_pool() const { return m_PagePool; }
+
+		inline std::pmr::memory_resource* upstream_resource() const { return m_Upstream; }
+
+		// Largest block served from a slab, larger blocks get pool pages of their own
+		inline size_t max_slot_size() const { return m_MaxSlotSize; }
+
+	protected:
+		void* do_allocate(size_t bytes, size_t alignment) override;
+
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+	private:
+		static constexpr unsigned char MIN_SLOT_SIZE_BITS = 3;
+
+		static constexpr size_t MAX_SIZE_CLASSES = 16;
+
+		// Block size rounded up to its size class, or 0 for blocks passed upstream
+		size_t block_size(size_t bytes, size_t alignment) const;
+
+		page_slab_base& slab(size_t size);
+
+		CPagePool& m_PagePool;
+		std::pmr::memory_resource* m_Upstream;
+		size_t m_MaxSlotSize;
+		std::array<std::unique_ptr<page_slab_base>, MAX_SIZE_CLASSES> m_Slabs;
+	};
+}
\ No newline at end of file
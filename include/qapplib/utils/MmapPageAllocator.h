@@ -0,0 +1,83 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifndef _WIN32
+
+#include <mutex>
+#include <vector>
+#include "PageAllocator.h"
+
+namespace qapp
+{
+	// Page allocator carving max pages out of large virtual regions reserved with mmap. Pages are aligned to the
+	// page size, so pages of 2 MiB and up can be backed by huge pages. A region is unmapped with a single munmap
+	// once all of its pages have been freed. Thread safe.
+	class CMmapPageAllocator : public IPageAllocator
+	{
+	public:
+		enum class EHugePages
+		{
+			None,
+			Transparent,  // madvise(MADV_HUGEPAGE) on each region
+			Explicit,     // mmap(MAP_HUGETLB) from the reserved huge page pool, falls back to Transparent when exhausted
+			              // or when the huge page size is unknown
+		};
+
+		CMmapPageAllocator(size_t page_size, size_t region_size = 256 << 20, EHugePages huge_pages = EHugePages::Transparent);
+		~CMmapPageAllocator();
+
+		size_t PageSize() const override { return m_PageSize; }
+		void*  AllocPage() override;
+		void   FreePage(void* page) override;
+		void   DecommitPage(void* page) override;
+
+	private:
+		struct SRegion
+		{
+			char*  m_Ptr = nullptr;
+			size_t m_Size = 0;
+			size_t m_CarvedSize = 0;  // Bytes of the region handed out at least once
+			size_t m_UsedPages = 0;
+			size_t m_HugePageSize = 0;  // Size of the explicit huge pages backing the region, 0 for regular mappings
+			std::vector<void*> m_FreePages;
+		};
+
+		SRegion* MapRegion();
+
+		void UnmapRegion(SRegion& region);
+
+		const size_t     m_PageSize;
+		const size_t     m_RegionSize;
+		const EHugePages m_HugePages;
+		std::mutex       m_Mutex;
+		std::vector<SRegion> m_Regions;  // Sorted by address
+	};
+
+	template <size_t TPageSize>
+	class TMmapPageAllocator : public CMmapPageAllocator
+	{
+	public:
+		TMmapPageAllocator(size_t region_size = 256 << 20, EHugePages huge_pages = EHugePages::Transparent)
+			: CMmapPageAllocator(TPageSize, region_size, huge_pages) {}
+	};
+}
+
+#endif
\ No newline at end of file
@@ -17,6 +17,8 @@ You should have received a copy of the GNU Lesser General Public License
 along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#pragma once
+
 #include <memory>
 #include <stdlib.h>
 
@@ -47,6 +49,20 @@ namespace qapp
 		#endif
 	}
 
+	// Lets the OS reclaim the physical memory of the whole system pages within [ptr, ptr + size) while keeping
+	// the address range valid. The contents of the range are undefined afterwards.
+	void decommit_pages(void* ptr, size_t size);
+
+	// Makes sure physical memory is backing [ptr, ptr + size). Writes to the range unless the OS can populate it
+	// without doing so, so the range must not be in use by anyone else.
+	void prefault_pages(void* ptr, size_t size);
+
+	// Maps size bytes of zeroed memory directly from the OS, aligned to the system page size. Throws std::bad_alloc.
+	void* map_pages(size_t size);
+
+	// Unmaps a range returned by map_pages, size must be the mapped size
+	void unmap_pages(void* ptr, size_t size);
+
 	class IPageAllocator
 	{
 	public:
@@ -54,6 +70,7 @@ namespace qapp
 		virtual size_t PageSize() const = 0;
 		virtual void*  AllocPage() = 0;
 		virtual void   FreePage(void* page) = 0;
+		virtual void   DecommitPage(void* /*page*/) {}  // Hint that the contents of an allocated but unused page can be discarded
 	};
 
 	template <size_t TPageSize>
@@ -63,5 +80,6 @@ namespace qapp
 		size_t PageSize() const override { return TPageSize; }
 		void*  AllocPage() override { return qapp::aligned_alloc(TPageSize >= 4096 ? 4096 : TPageSize, TPageSize); }
 		void   FreePage(void* page) override { qapp::aligned_free(page); };
+		void   DecommitPage(void* page) override { qapp::decommit_pages(page, TPageSize); }
 	};
 }
\ No newline at end of file
@@ -19,14 +19,116 @@ along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <type_traits>
+#include "Hash.h"
 #include "PagePool.h"
 
+class QIODevice;
+
 namespace qapp
 {
+	// Maps buffer offsets to pages. A relocating buffer has pages of a single size: one page that is replaced by a
+	// bigger one while the buffer grows, then max pages. A chained buffer never moves its contents, its pages double
+	// in size up to the max page size (min, min, 2 min, 4 min, ..., max, max, ...) so the page holding an offset
+	// follows from the offset's highest set bit.
+	struct page_buffer_layout
+	{
+		unsigned char m_PageSizeBits = 0;  // Size of all pages when relocating, of the first page when chained
+		unsigned char m_PageSizeMaxBits = 0;
+		bool          m_Chained = false;
+
+		inline void locate(size_t offset, size_t& ret_page_index, size_t& ret_page_offset) const
+		{
+			if (m_Chained && offset < ((size_t)2 << m_PageSizeMaxBits))
+			{
+				ret_page_index = std::bit_width(offset >> m_PageSizeBits);
+				ret_page_offset = ret_page_index ? offset - ((size_t)1 << (m_PageSizeBits + ret_page_index - 1)) : offset;
+				return;
+			}
+			const auto page_size_bits = m_Chained ? m_PageSizeMaxBits : m_PageSizeBits;
+			ret_page_index = (offset >> page_size_bits) + (m_Chained ? m_PageSizeMaxBits - m_PageSizeBits : 0);
+			ret_page_offset = offset & (((size_t)1 << page_size_bits) - 1);
+		}
+
+		inline size_t page_size(size_t page_index) const
+		{
+			if (!m_Chained || !page_index)
+				return (size_t)1 << m_PageSizeBits;
+			return (size_t)1 << std::min<size_t>(m_PageSizeBits + page_index - 1, m_PageSizeMaxBits);
+		}
+
+		// Total size of the first page_count pages
+		inline size_t capacity(size_t page_count) const
+		{
+			if (!m_Chained)
+				return page_count << m_PageSizeBits;
+			const size_t doubling_page_count = m_PageSizeMaxBits - m_PageSizeBits + 2;  // Up to the first max page
+			if (page_count <= doubling_page_count)
+				return page_count ? (size_t)1 << (m_PageSizeBits + page_count - 1) : 0;
+			return ((size_t)2 << m_PageSizeMaxBits) + ((page_count - doubling_page_count) << m_PageSizeMaxBits);
+		}
+
+		// Number of pages needed to hold size bytes
+		inline size_t page_count(size_t size) const
+		{
+			if (!size)
+				return 0;
+			size_t page_index, page_offset;
+			locate(size - 1, page_index, page_offset);
+			return page_index + 1;
+		}
+	};
+
+	// Immutable view of the contents a page_buffer had when page_buffer::snapshot was called. Shares the pages
+	// with the buffer, which copies a page only when writing to it while it is shared. Snapshots can be copied
+	// and read from any thread, but the last one to go away frees pages, so a pool shared between threads has
+	// to be in concurrent mode.
+	class page_buffer_snapshot
+	{
+	public:
+		inline size_t size() const { return m_State ? m_State->m_Size : 0; }
+
+		inline bool empty() const { return 0 == size(); }
+
+		size_t read(size_t offset, void* buffer, size_t buffer_size) const;
+
+		// Same as page_buffer::for_each_segment
+		template <class TLambda>
+		void for_each_segment(size_t offset, size_t size, TLambda&& fn) const;
+
+	private:
+		friend class page_buffer;
+
+		struct state
+		{
+			~state();
+
+			CPagePool* m_PagePool = nullptr;
+			size_t m_Size = 0;
+			page_buffer_layout m_Layout;
+			std::vector<CPagePool::handle_t> m_Pages;
+			std::vector<bool> m_OwnedPages;  // Pages freed with this state, the others are owned by an ancestor
+			std::shared_ptr<state> m_Parent;  // Previous snapshot of the same buffer
+		};
+
+		std::shared_ptr<const state> m_State;
+	};
+
 	class page_buffer
 	{
 	public:
-		page_buffer(CPagePool& page_pool = CPagePool::DefaultPagePool());
+		enum class EGrowth
+		{
+			Relocate,  // Contents are moved to a bigger page while smaller than the max page size
+			Chain,     // Pages of doubling size are chained, contents never move
+		};
+
+		static constexpr size_t npos = SIZE_MAX;
+
+		page_buffer(CPagePool& page_pool = CPagePool::DefaultPagePool(), EGrowth growth = EGrowth::Relocate);
 		~page_buffer();
 
 		void clear();
@@ -37,22 +139,108 @@ namespace qapp
 
 		void reserve(size_t size);
 
+		// Returns all pages not needed to hold the current contents to the page pool
+		void shrink_to_fit();
+
 		void append(const void* data, size_t size);
 
 		void write(size_t offset, const void* data, size_t size);
 
 		size_t read(size_t offset, void* buffer, size_t buffer_size) const;
 
+		// Return the offset of the first occurrence at or after offset, or npos. Matches may straddle pages.
+		size_t find(uint8_t byte, size_t offset = 0) const;
+		size_t find(const void* pattern, size_t pattern_size, size_t offset = 0) const;
+
+		// Returns the number of occurrences of byte in [offset, offset + size)
+		size_t count(uint8_t byte, size_t offset = 0, size_t size = npos) const;
+
+		// hash64 and hash128 of [offset, offset + size), clamped to the buffer size
+		uint64_t hash(size_t offset = 0, size_t size = npos) const;
+		hash128_t hash128(size_t offset = 0, size_t size = npos) const;
+
+		// Hash of the whole contents for change detection. Combines cached hashes of blocks of the min page size, so
+		// only the blocks modified since the previous call are hashed again. Equal for equal contents on pools with
+		// the same min page size, but not equal to hash().
+		uint64_t content_hash() const;
+
 		inline size_t size() const { return m_Size; }
 
-	private:
-		inline size_t capacity() const { return m_Capacity; }
+		inline CPagePool& page_pool() const { return m_PagePool; }
+
+		page_buffer_snapshot snapshot();
+
+		// Calls fn(const void* page, size_t page_size) for each page holding the buffer contents, in order
+		template <class TLambda>
+		void for_each_page(TLambda&& fn) const;
+
+		// Calls fn(const void* data, size_t size) for each contiguous part of [offset, offset + size) in order,
+		// clamped to the buffer size. Returning false from fn stops the iteration.
+		template <class TLambda>
+		void for_each_segment(size_t offset, size_t size, TLambda&& fn) const;
+
+		// Grows the buffer to hold [offset, offset + size) like write does and calls fn(void* data, size_t size)
+		// for each contiguous part of it in order, for the caller to fill in place
+		template <class TLambda>
+		void for_each_writable_segment(size_t offset, size_t size, TLambda&& fn);
+
+		// Makes the page holding offset writable, growing the capacity as needed, and returns a pointer to offset.
+		// ret_size receives the number of bytes from offset to the end of that page. The size of the buffer is left
+		// unchanged, the caller publishes what it wrote with resize.
+		void* writable_page_at(size_t offset, size_t& ret_size);
 
-		void locate(size_t offset, size_t& ret_page_index, size_t& ret_page_offset) const;
+		// Writer filling a page from writable_page_at in place across operations, like the put area of
+		// page_buffer_ostream. snapshot and content_hash detach the open writers first: detach must publish what was
+		// written, call remove_writer and get the page from writable_page_at again before writing on.
+		class in_place_writer
+		{
+		public:
+			virtual void detach() = 0;
 
-		size_t page_size() const;
+		protected:
+			~in_place_writer() = default;
+		};
 
-		unsigned char page_size_max_bits() const;
+		void add_writer(in_place_writer* writer);
+		void remove_writer(in_place_writer* writer);
+
+		// Compresses pages that have not been accessed during the last idle_operations operations (reads, writes and
+		// iterations) on the buffer, a page now and then as the buffer is used, and decompresses them again on
+		// access. 0 turns compression off. Pages shared with snapshots are left alone. Compressed pages make const
+		// members modify the buffer internally, so the buffer must not be accessed from several threads at once,
+		// pages from for_each_page stay valid only until the next operation and the buffer can not be exported.
+		void set_compression(size_t idle_operations);
+
+		// Compresses all cold pages at once, for example while the application is idle. Returns the number of
+		// pages compressed.
+		size_t compress_cold_pages();
+
+		// Keeps the page holding offset from being compressed until unpin_page is called with the same offset, for
+		// callers holding on to a page pointer across operations, like the stream get and put areas
+		void pin_page(size_t offset) const;
+		void unpin_page(size_t offset) const;
+
+#ifndef _WIN32
+		// Writes [offset, offset + size) to fd with one writev per batch of pages, at the file position or, when
+		// file_offset is not negative, at file_offset with pwritev. Returns the number of bytes written, which is
+		// less than size only if the buffer ends first.
+		size_t write_to(int fd, size_t offset, size_t size, int64_t file_offset = -1) const;
+
+		// Reads size bytes from fd into [offset, offset + size) with one readv per batch of pages, growing the
+		// buffer as needed. Reads at the file position or, when file_offset is not negative, at file_offset with
+		// preadv. Returns the number of bytes read, which is less than size only if the file ends first.
+		size_t read_from(int fd, size_t offset, size_t size, int64_t file_offset = -1);
+#endif
+
+		// Same as above for Qt devices. Files are transferred through their descriptor at the device position,
+		// other devices a segment at a time.
+		size_t write_to(QIODevice& device, size_t offset, size_t size) const;
+		size_t read_from(QIODevice& device, size_t offset, size_t size);
+
+	private:
+		inline size_t capacity() const { return m_Capacity; }
+
+		void add_page(size_t page_size);
 
 		size_t page_size_min() const;
 
@@ -61,9 +249,140 @@ namespace qapp
 		void* page_ptr(size_t page_index);
 		const void* page_ptr(size_t page_index) const;
 
+		void* writable_page_ptr(size_t offset, size_t& ret_size);
+
+		void on_operation() const;
+
+		void detach_writers() const;
+
+		const void* access_page(size_t page_index) const;
+
+		bool is_cold(size_t page_index) const;
+
+		bool compress_page(size_t page_index) const;
+
+		void decompress_page(size_t page_index) const;
+
+		void invalidate_hashes(size_t beg, size_t end);
+
+		void make_page_writable(size_t page_index);
+
+		void reclaim_snapshot();
+
+		void release_page(size_t page_index);
+
+		void truncate_pages(size_t page_count);
+
+		void trim_capacity();
+
+		template <class TLambda, typename TPtr>
+		inline static bool invoke_segment_fn(TLambda& fn, TPtr data, size_t size);
+
+		friend class page_buffer_snapshot;
+		friend class page_rope;
+		friend class shared_page_buffer_view;
+
+		struct compression_state;
+		struct hash_cache;
+
 		CPagePool& m_PagePool;
 		size_t m_Size = 0;
 		size_t m_Capacity = 0;
-		std::vector<CPagePool::handle_t> m_Pages;
+		page_buffer_layout m_Layout;
+		mutable std::vector<CPagePool::handle_t> m_Pages;  // Compressed pages are replaced on access, also when const
+		std::vector<bool> m_SharedPages;  // Pages owned by m_Snapshot or one of its ancestors
+		std::shared_ptr<page_buffer_snapshot::state> m_Snapshot;
+		std::unique_ptr<compression_state> m_Compression;
+		mutable std::vector<size_t> m_PinnedPages;  // Page index per pin_page call, never compressed
+		std::vector<in_place_writer*> m_Writers;
+		mutable std::unique_ptr<hash_cache> m_HashCache;  // Created by content_hash
 	};
+
+	template <class TLambda>
+	void page_buffer::for_each_page(TLambda&& fn) const
+	{
+		if (m_Compression)
+			on_operation();
+		const auto page_count = m_Layout.page_count(size());
+		for (size_t i = 0; i < page_count; ++i)
+			fn(page_ptr(i), m_Layout.page_size(i));
+	}
+
+	template <class TLambda>
+	void page_buffer::for_each_segment(size_t offset, size_t size, TLambda&& fn) const
+	{
+		if (offset >= this->size())
+			return;
+		if (m_Compression)
+			on_operation();
+		size = std::min(size, this->size() - offset);
+		size_t page_index, page_offset;
+		m_Layout.locate(offset, page_index, page_offset);
+		while (size)
+		{
+			const auto n = std::min(m_Layout.page_size(page_index) - page_offset, size);
+			if (!invoke_segment_fn(fn, (const void*)((const char*)page_ptr(page_index) + page_offset), n))
+				return;
+			size -= n;
+			++page_index;
+			page_offset = 0;
+		}
+	}
+
+	template <class TLambda>
+	void page_buffer::for_each_writable_segment(size_t offset, size_t size, TLambda&& fn)
+	{
+		reserve(offset + size);
+		if (m_HashCache)
+			invalidate_hashes(std::min(offset, m_Size), offset + size);
+		m_Size = std::max(m_Size, offset + size);
+		if (m_Compression)
+			on_operation();
+		size_t page_index, page_offset;
+		m_Layout.locate(offset, page_index, page_offset);
+		while (size)
+		{
+			const auto n = std::min(m_Layout.page_size(page_index) - page_offset, size);
+			if (m_Snapshot)
+				make_page_writable(page_index);
+			if (!invoke_segment_fn(fn, (void*)((char*)page_ptr(page_index) + page_offset), n))
+				return;
+			size -= n;
+			++page_index;
+			page_offset = 0;
+		}
+	}
+
+	template <class TLambda, typename TPtr>
+	inline bool page_buffer::invoke_segment_fn(TLambda& fn, TPtr data, size_t size)
+	{
+		if constexpr (std::is_void_v<std::invoke_result_t<TLambda&, TPtr, size_t>>)
+		{
+			fn(data, size);
+			return true;
+		}
+		else
+			return fn(data, size);
+	}
+
+	template <class TLambda>
+	void page_buffer_snapshot::for_each_segment(size_t offset, size_t size, TLambda&& fn) const
+	{
+		if (offset >= this->size())
+			return;
+		size = std::min(size, this->size() - offset);
+		const auto& pool = *m_State->m_PagePool;
+		const auto& layout = m_State->m_Layout;
+		size_t page_index, page_offset;
+		layout.locate(offset, page_index, page_offset);
+		while (size)
+		{
+			const auto n = std::min(layout.page_size(page_index) - page_offset, size);
+			if (!page_buffer::invoke_segment_fn(fn, (const void*)((const char*)pool.PtrFromHandle(m_State->m_Pages[page_index]) + page_offset), n))
+				return;
+			size -= n;
+			++page_index;
+			page_offset = 0;
+		}
+	}
 }
\ No newline at end of file
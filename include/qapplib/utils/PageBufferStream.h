@@ -21,19 +21,24 @@ along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 
 #include <iostream>
 #include "PageBuffer.h"
+#include "PageRope.h"
 
 namespace qapp
 {
-	class page_buffer_istream : public std::istream
+	// Reads [beg, end) of a page_buffer, page_rope or shared_page_buffer_view. The page under the read position is
+	// exposed as the get area, so the buffer must not be modified while the stream reads from it.
+	template <class TBuffer>
+	class basic_page_istream : public std::istream
 	{
 	public:
-		page_buffer_istream(const page_buffer& buffer, size_t beg, size_t end);
+		basic_page_istream(const TBuffer& buffer, size_t beg, size_t end);
 
 	private:
 		class streambuf : public std::streambuf
 		{
 		public:
-			streambuf(const page_buffer& buffer, size_t beg, size_t end);
+			streambuf(const TBuffer& buffer, size_t beg, size_t end);
+			~streambuf();
 
 		protected:
 			std::streamsize xsgetn(char* s, std::streamsize n) override;
@@ -41,35 +46,53 @@ namespace qapp
 			std::streampos seekoff(std::streamoff off, ios_base::seekdir way, ios_base::openmode which) override;
 			std::streampos seekpos(std::streampos sp, ios_base::openmode which) override;
 
-			const page_buffer* m_Buffer = nullptr;
+			size_t position() const;
+
+			void drop_get_area();
+
+			const TBuffer* m_Buffer = nullptr;
 			size_t m_Beg = 0;
-			size_t m_Cur = 0;
+			size_t m_Cur = 0;  // Buffer offset of eback()
 			size_t m_End = 0;
+			bool m_Pinned = false;  // The page under the get area is pinned against compression
 		};
 
 		streambuf m_StreamBuf;
 	};
 
+	typedef basic_page_istream<page_buffer> page_buffer_istream;
+	typedef basic_page_istream<page_rope> page_rope_istream;
+
+	// Writes to a page_buffer from beg on. The page under the write position is exposed as the put area and
+	// written in place, the buffer size catches up on flush, seek and destruction. snapshot and content_hash of the
+	// buffer flush the stream themselves, flush it before reading or resizing the buffer.
 	class page_buffer_ostream : public std::ostream
 	{
 	public:
 		page_buffer_ostream(page_buffer& buffer, size_t beg = 0);
 
 	private:
-		class streambuf : public std::streambuf
+		class streambuf : public std::streambuf, private page_buffer::in_place_writer
 		{
 		public:
 			streambuf(page_buffer& buffer, size_t beg);
+			~streambuf();
 
 		protected:
 			std::streamsize xsputn(const char* s, std::streamsize n) override;
 			std::streambuf::int_type overflow(std::streambuf::int_type c) override;
+			int sync() override;
 			std::streampos seekoff(std::streamoff off, ios_base::seekdir way, ios_base::openmode which) override;
 			std::streampos seekpos(std::streampos sp, ios_base::openmode which) override;
 
+			size_t position() const;
+
+			void detach() override;
+
 			page_buffer* m_Buffer = nullptr;
 			size_t m_Beg = 0;
-			size_t m_Cur = 0;
+			size_t m_Cur = 0;  // Buffer offset of pbase()
+			bool m_Attached = false;  // The put area is open, its page pinned and the stream registered as writer
 		};
 
 		streambuf m_StreamBuf;
@@ -0,0 +1,572 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <qapplib/Debug.h>
+
+#include "Bits.h"
+#include "PagePool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define QAPP_PAGE_HASH_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace qapp
+{
+	// Control bytes of 16 consecutive slots, matched at once. A control byte is EMPTY, DELETED or the 7 low bits of
+	// the hash of a full slot.
+	class page_hash_group
+	{
+	public:
+		static constexpr size_t SIZE = 16;
+		static constexpr int8_t EMPTY = -128;
+		static constexpr int8_t DELETED = -2;
+
+#ifdef QAPP_PAGE_HASH_SSE2
+		inline page_hash_group(const int8_t* ctrl) : m_Ctrl(_mm_load_si128((const __m128i*)ctrl)) {}
+
+		inline uint32_t match(int8_t h2) const { return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(m_Ctrl, _mm_set1_epi8(h2))); }
+
+		inline uint32_t match_empty() const { return match(EMPTY); }
+
+		inline uint32_t match_empty_or_deleted() const { return (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), m_Ctrl)); }
+
+	private:
+		__m128i m_Ctrl;
+#else
+		inline page_hash_group(const int8_t* ctrl) : m_Ctrl(ctrl) {}
+
+		inline uint32_t match(int8_t h2) const
+		{
+			uint32_t mask = 0;
+			for (size_t i = 0; i < SIZE; ++i)
+				mask |= (uint32_t)(m_Ctrl[i] == h2) << i;
+			return mask;
+		}
+
+		inline uint32_t match_empty() const { return match(EMPTY); }
+
+		inline uint32_t match_empty_or_deleted() const
+		{
+			uint32_t mask = 0;
+			for (size_t i = 0; i < SIZE; ++i)
+				mask |= (uint32_t)(m_Ctrl[i] < -1) << i;
+			return mask;
+		}
+
+	private:
+		const int8_t* m_Ctrl;
+#endif
+	};
+
+	// Open addressing hash table on pool pages, the base of page_hash_map and page_hash_set. Slots are probed a
+	// page_hash_group at a time. Each page holds the control bytes of a run of whole groups followed by their slots,
+	// as many as fill the page, and the page size is picked to waste the least pool memory for the capacity.
+	// Growing rehashes into new pages and invalidates iterators and pointers to elements, erasing invalidates only
+	// the erased element. The load factor is kept at or below 7/8.
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	class page_hash_table
+	{
+	public:
+		typedef TSlot value_type;
+		typedef size_t size_type;
+
+		template <bool IsConst>
+		class basic_iterator;
+
+		typedef basic_iterator<false> iterator;
+		typedef basic_iterator<true> const_iterator;
+
+		page_hash_table(CPagePool& page_pool);
+		~page_hash_table();
+
+		page_hash_table(page_hash_table&& other);
+
+		page_hash_table(const page_hash_table&) = delete;
+		page_hash_table& operator=(const page_hash_table&) = delete;
+
+		// Destroys all elements and returns all pages to the pool
+		void clear();
+
+		inline bool empty() const { return 0 == m_Size; }
+
+		inline size_t size() const { return m_Size; }
+
+		inline size_t capacity() const { return m_Capacity; }
+
+		inline CPagePool& page_pool() const { return m_PagePool; }
+
+		// Makes room for size elements without rehashing
+		void reserve(size_t size);
+
+		inline iterator find(const TKey& key) { return iterator(this, find_pos(key, hash(key)), false); }
+
+		inline const_iterator find(const TKey& key) const { return const_iterator(this, find_pos(key, hash(key)), false); }
+
+		inline bool contains(const TKey& key) const { return find_pos(key, hash(key)) != m_Capacity; }
+
+		inline size_t count(const TKey& key) const { return contains(key) ? 1 : 0; }
+
+		// Returns the number of erased elements
+		size_t erase(const TKey& key);
+
+		// Returns the iterator following it
+		iterator erase(const_iterator it);
+
+		inline iterator begin() { return iterator(this, 0, true); }
+
+		inline iterator end() { return iterator(this, m_Capacity, false); }
+
+		inline const_iterator begin() const { return const_iterator(this, 0, true); }
+
+		inline const_iterator end() const { return const_iterator(this, m_Capacity, false); }
+
+	protected:
+		struct insert_pos
+		{
+			size_t   m_Pos;
+			uint64_t m_Hash;
+			bool     m_Found;
+		};
+
+		// Finds the slot of key or a free slot for it, rehashing when the table is full
+		insert_pos find_or_prepare_insert(const TKey& key);
+
+		// Marks the slot of a prepared insert full once the element has been constructed in it
+		inline void commit_insert(const insert_pos& pos);
+
+		inline TSlot* slot_ptr(size_t pos) const { return (TSlot*)(m_Pages[pos / m_PageSlots] + m_SlotsOffset) + pos % m_PageSlots; }
+
+	private:
+		inline int8_t* ctrl_ptr(size_t pos) const { return (int8_t*)m_Pages[pos / m_PageSlots] + pos % m_PageSlots; }
+
+		inline size_t growth_limit() const { return m_Capacity - m_Capacity / 8; }
+
+		// std::hash of integers is the identity, so mix the bits before splitting the hash into group and control byte
+		inline uint64_t hash(const TKey& key) const
+		{
+			const auto h = (uint64_t)m_Hash(key) * 0x9E3779B97F4A7C15ull;
+			return h ^ (h >> 32);
+		}
+
+		// Returns m_Capacity if not found
+		size_t find_pos(const TKey& key, uint64_t hash) const;
+
+		size_t find_free_pos(uint64_t hash) const;
+
+		void erase_pos(size_t pos);
+
+		void rehash(size_t capacity);
+
+		void allocate(size_t capacity);
+
+		// Destroys all elements and frees all pages
+		void release();
+
+		CPagePool&         m_PagePool;
+		std::vector<char*> m_Pages;
+		size_t             m_Capacity = 0;
+		size_t             m_Size = 0;
+		size_t             m_GrowthLeft = 0;  // Inserts into empty slots left before rehashing
+		size_t             m_SlotsOffset = 0;
+		size_t             m_PageSlots = 0;  // Slots per page, a multiple of the group size
+		unsigned char      m_PageSizeBits = 0;
+		[[no_unique_address]] THash m_Hash;
+		[[no_unique_address]] TEq   m_Eq;
+	};
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	template <bool IsConst>
+	class page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::basic_iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef TSlot value_type;
+		typedef ptrdiff_t difference_type;
+		typedef std::conditional_t<IsConst, const TSlot*, TSlot*> pointer;
+		typedef std::conditional_t<IsConst, const TSlot&, TSlot&> reference;
+		typedef std::conditional_t<IsConst, const page_hash_table*, page_hash_table*> table_pointer;
+
+		basic_iterator() = default;
+
+		inline basic_iterator(table_pointer table, size_t pos, bool skip_free) : m_Table(table), m_Pos(pos)
+		{
+			if (skip_free)
+				skip();
+		}
+
+		inline operator basic_iterator<true>() const { return basic_iterator<true>(m_Table, m_Pos, false); }
+
+		inline size_t pos() const { return m_Pos; }
+
+		inline reference operator*() const { return *m_Table->slot_ptr(m_Pos); }
+
+		inline pointer operator->() const { return m_Table->slot_ptr(m_Pos); }
+
+		inline basic_iterator& operator++() { ++m_Pos; skip(); return *this; }
+
+		inline basic_iterator operator++(int) { auto it = *this; ++*this; return it; }
+
+		inline bool operator==(const basic_iterator& other) const { return m_Pos == other.m_Pos; }
+
+	private:
+		inline void skip()
+		{
+			while (m_Pos < m_Table->m_Capacity && *m_Table->ctrl_ptr(m_Pos) < 0)
+				++m_Pos;
+		}
+
+		table_pointer m_Table = nullptr;
+		size_t m_Pos = 0;
+	};
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::page_hash_table(CPagePool& page_pool)
+		: m_PagePool(page_pool)
+	{
+		QAPP_ASSERT(alignof(TSlot) <= page_pool.PageSizeMin());
+		QAPP_ASSERT(page_hash_group::SIZE * (sizeof(TSlot) + 1) + alignof(TSlot) <= page_pool.PageSizeMax());
+	}
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::~page_hash_table()
+	{
+		release();
+	}
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::page_hash_table(page_hash_table&& other)
+		: m_PagePool(other.m_PagePool)
+		, m_Pages(std::move(other.m_Pages))
+		, m_Capacity(other.m_Capacity)
+		, m_Size(other.m_Size)
+		, m_GrowthLeft(other.m_GrowthLeft)
+		, m_SlotsOffset(other.m_SlotsOffset)
+		, m_PageSlots(other.m_PageSlots)
+		, m_PageSizeBits(other.m_PageSizeBits)
+		, m_Hash(std::move(other.m_Hash))
+		, m_Eq(std::move(other.m_Eq))
+	{
+		other.m_Pages.clear();
+		other.m_Capacity = 0;
+		other.m_Size = 0;
+		other.m_GrowthLeft = 0;
+	}
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	void page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::clear()
+	{
+		release();
+	}
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	void page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::reserve(size_t size)
+	{
+		auto capacity = std::max(m_Capacity, page_hash_group::SIZE);
+		while (capacity - capacity / 8 < size)
+			capacity *= 2;
+		if (capacity != m_Capacity)
+			rehash(capacity);
+	}
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	size_t page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::erase(const TKey& key)
+	{
+		const auto pos = find_pos(key, hash(key));
+		if (pos == m_Capacity)
+			return 0;
+		erase_pos(pos);
+		return 1;
+	}
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	typename page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::iterator page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::erase(const_iterator it)
+	{
+		erase_pos(it.pos());
+		return iterator(this, it.pos() + 1, true);
+	}
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	typename page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::insert_pos page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::find_or_prepare_insert(const TKey& key)
+	{
+		const auto h = hash(key);
+		const auto pos = find_pos(key, h);
+		if (pos != m_Capacity)
+			return { pos, h, true };
+		if (m_Capacity)
+		{
+			const auto free_pos = find_free_pos(h);
+			if (m_GrowthLeft || *ctrl_ptr(free_pos) == page_hash_group::DELETED)
+				return { free_pos, h, false };
+		}
+		// Full, grow unless mostly tombstones are taking up the room
+		rehash(m_Capacity && m_Size < m_Capacity / 2 ? m_Capacity : std::max(m_Capacity * 2, page_hash_group::SIZE));
+		return { find_free_pos(h), h, false };
+	}
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	inline void page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::commit_insert(const insert_pos& pos)
+	{
+		auto* ctrl = ctrl_ptr(pos.m_Pos);
+		if (*ctrl == page_hash_group::EMPTY)
+			--m_GrowthLeft;
+		*ctrl = (int8_t)(pos.m_Hash & 0x7F);
+		++m_Size;
+	}
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	size_t page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::find_pos(const TKey& key, uint64_t hash) const
+	{
+		if (!m_Size)
+			return m_Capacity;
+		const auto h2 = (int8_t)(hash & 0x7F);
+		const auto group_mask = m_Capacity / page_hash_group::SIZE - 1;
+		auto group_index = (size_t)(hash >> 7) & group_mask;
+		for (size_t step = 1;; ++step)
+		{
+			// Groups never straddle pages, locate the page once per group
+			const auto group_pos = group_index * page_hash_group::SIZE;
+			const auto* page = m_Pages[group_pos / m_PageSlots];
+			const auto page_pos = group_pos % m_PageSlots;
+			const auto* slots = (const TSlot*)(page + m_SlotsOffset) + page_pos;
+			const page_hash_group group((const int8_t*)page + page_pos);
+			for (auto match = group.match(h2); match; match &= match - 1)
+			{
+				const auto i = std::countr_zero(match);
+				if (m_Eq(TKeyOf::get(slots[i]), key))
+					return group_pos + i;
+			}
+			if (group.match_empty())
+				return m_Capacity;
+			group_index = (group_index + step) & group_mask;
+		}
+	}
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	size_t page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::find_free_pos(uint64_t hash) const
+	{
+		const auto group_mask = m_Capacity / page_hash_group::SIZE - 1;
+		auto group_index = (size_t)(hash >> 7) & group_mask;
+		for (size_t step = 1;; ++step)
+		{
+			const auto group_pos = group_index * page_hash_group::SIZE;
+			if (const auto match = page_hash_group(ctrl_ptr(group_pos)).match_empty_or_deleted())
+				return group_pos + std::countr_zero(match);
+			group_index = (group_index + step) & group_mask;
+		}
+	}
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	void page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::erase_pos(size_t pos)
+	{
+		QAPP_ASSERT(pos < m_Capacity && *ctrl_ptr(pos) >= 0);
+		slot_ptr(pos)->~TSlot();
+		--m_Size;
+		// Lookups stop at the first group with an empty slot, so a slot in such a group can become empty again
+		const auto group_pos = pos & ~(page_hash_group::SIZE - 1);
+		if (page_hash_group(ctrl_ptr(group_pos)).match_empty())
+		{
+			*ctrl_ptr(pos) = page_hash_group::EMPTY;
+			++m_GrowthLeft;
+		}
+		else
+			*ctrl_ptr(pos) = page_hash_group::DELETED;
+	}
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	void page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::rehash(size_t capacity)
+	{
+		page_hash_table table(m_PagePool);
+		table.allocate(capacity);
+		for (size_t pos = 0; pos < m_Capacity; ++pos)
+		{
+			if (*ctrl_ptr(pos) < 0)
+				continue;
+			auto& slot = *slot_ptr(pos);
+			const auto h = hash(TKeyOf::get(slot));
+			const insert_pos new_pos{ table.find_free_pos(h), h, false };
+			new (table.slot_ptr(new_pos.m_Pos)) TSlot(std::move(slot));
+			table.commit_insert(new_pos);
+		}
+		release();
+		std::swap(m_Pages, table.m_Pages);
+		std::swap(m_Capacity, table.m_Capacity);
+		std::swap(m_Size, table.m_Size);
+		std::swap(m_GrowthLeft, table.m_GrowthLeft);
+		std::swap(m_SlotsOffset, table.m_SlotsOffset);
+		std::swap(m_PageSlots, table.m_PageSlots);
+		std::swap(m_PageSizeBits, table.m_PageSizeBits);
+	}
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	void page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::allocate(size_t capacity)
+	{
+		QAPP_ASSERT(m_Pages.empty() && std::has_single_bit(capacity) && capacity >= page_hash_group::SIZE);
+		auto page_bytes = [&](size_t slot_count) { return align_up(slot_count, alignof(TSlot)) + slot_count * sizeof(TSlot); };
+		// Try each page size with as many whole groups per page as fit and keep the one needing the least memory,
+		// the bigger page on ties. Only the last page is partly used.
+		size_t best_bytes = SIZE_MAX;
+		for (auto bits = m_PagePool.PageSizeMinBits(); bits <= m_PagePool.PageSizeMaxBits(); ++bits)
+		{
+			const auto page_size = (size_t)1 << bits;
+			auto slot_count = std::min(capacity, (page_size - alignof(TSlot)) / (sizeof(TSlot) + 1) / page_hash_group::SIZE * page_hash_group::SIZE);
+			while (slot_count && page_bytes(slot_count) > page_size)
+				slot_count -= page_hash_group::SIZE;
+			if (!slot_count)
+				continue;
+			const auto bytes = (capacity + slot_count - 1) / slot_count * page_size;
+			if (bytes <= best_bytes)
+			{
+				best_bytes = bytes;
+				m_PageSlots = slot_count;
+				m_PageSizeBits = bits;
+			}
+		}
+		m_Capacity = capacity;
+		m_GrowthLeft = growth_limit();
+		m_SlotsOffset = align_up(m_PageSlots, alignof(TSlot));
+		const auto page_count = (capacity + m_PageSlots - 1) / m_PageSlots;
+		m_Pages.reserve(page_count);
+		for (size_t i = 0; i < page_count; ++i)
+		{
+			auto* page = (char*)m_PagePool.PtrFromHandle(m_PagePool.Alloc(m_PageSizeBits));
+			memset(page, page_hash_group::EMPTY, m_PageSlots);
+			m_Pages.push_back(page);
+		}
+	}
+
+	template <class TKey, class TSlot, class TKeyOf, class THash, class TEq>
+	void page_hash_table<TKey, TSlot, TKeyOf, THash, TEq>::release()
+	{
+		if constexpr (!std::is_trivially_destructible_v<TSlot>)
+		{
+			for (size_t pos = 0; m_Size && pos < m_Capacity; ++pos)
+			{
+				if (*ctrl_ptr(pos) >= 0)
+				{
+					slot_ptr(pos)->~TSlot();
+					--m_Size;
+				}
+			}
+		}
+		for (auto* page : m_Pages)
+			m_PagePool.Free(m_PagePool.HandleFromPtr(page, m_PageSizeBits));
+		m_Pages.clear();
+		m_Capacity = 0;
+		m_Size = 0;
+		m_GrowthLeft = 0;
+	}
+
+	struct page_hash_map_key_of
+	{
+		template <class TSlot>
+		static inline const auto& get(const TSlot& slot) { return slot.first; }
+	};
+
+	struct page_hash_set_key_of
+	{
+		template <class TSlot>
+		static inline const TSlot& get(const TSlot& slot) { return slot; }
+	};
+
+	// Flat hash map on pool pages, see page_hash_table. Elements are std::pair<TKey, TValue> with a mutable key that
+	// must not be modified.
+	template <class TKey, class TValue, class THash = std::hash<TKey>, class TEq = std::equal_to<TKey>>
+	class page_hash_map : public page_hash_table<TKey, std::pair<TKey, TValue>, page_hash_map_key_of, THash, TEq>
+	{
+		typedef page_hash_table<TKey, std::pair<TKey, TValue>, page_hash_map_key_of, THash, TEq> base;
+
+	public:
+		typedef TKey key_type;
+		typedef TValue mapped_type;
+		typedef typename base::iterator iterator;
+		typedef typename base::const_iterator const_iterator;
+
+		page_hash_map(CPagePool& page_pool = CPagePool::DefaultPagePool()) : base(page_pool) {}
+
+		template <class TKeyArg, typename... TArgs>
+		std::pair<iterator, bool> try_emplace(TKeyArg&& key, TArgs&&... args)
+		{
+			const auto pos = this->find_or_prepare_insert(key);
+			if (!pos.m_Found)
+			{
+				new (this->slot_ptr(pos.m_Pos)) std::pair<TKey, TValue>(std::piecewise_construct, std::forward_as_tuple(std::forward<TKeyArg>(key)), std::forward_as_tuple(std::forward<TArgs>(args)...));
+				this->commit_insert(pos);
+			}
+			return { iterator(this, pos.m_Pos, false), !pos.m_Found };
+		}
+
+		template <class TKeyArg, class TValueArg>
+		std::pair<iterator, bool> insert_or_assign(TKeyArg&& key, TValueArg&& value)
+		{
+			auto result = try_emplace(std::forward<TKeyArg>(key), std::forward<TValueArg>(value));
+			if (!result.second)
+				result.first->second = std::forward<TValueArg>(value);
+			return result;
+		}
+
+		inline std::pair<iterator, bool> insert(const std::pair<TKey, TValue>& value) { return try_emplace(value.first, value.second); }
+
+		inline std::pair<iterator, bool> insert(std::pair<TKey, TValue>&& value) { return try_emplace(std::move(value.first), std::move(value.second)); }
+
+		inline TValue& operator[](const TKey& key) { return try_emplace(key).first->second; }
+
+		inline TValue& operator[](TKey&& key) { return try_emplace(std::move(key)).first->second; }
+	};
+
+	// Flat hash set on pool pages, see page_hash_table
+	template <class TKey, class THash = std::hash<TKey>, class TEq = std::equal_to<TKey>>
+	class page_hash_set : public page_hash_table<TKey, TKey, page_hash_set_key_of, THash, TEq>
+	{
+		typedef page_hash_table<TKey, TKey, page_hash_set_key_of, THash, TEq> base;
+
+	public:
+		typedef TKey key_type;
+		typedef typename base::iterator iterator;
+		typedef typename base::const_iterator const_iterator;
+
+		page_hash_set(CPagePool& page_pool = CPagePool::DefaultPagePool()) : base(page_pool) {}
+
+		template <class TKeyArg>
+		std::pair<iterator, bool> insert(TKeyArg&& key)
+		{
+			const auto pos = this->find_or_prepare_insert(key);
+			if (!pos.m_Found)
+			{
+				new (this->slot_ptr(pos.m_Pos)) TKey(std::forward<TKeyArg>(key));
+				this->commit_insert(pos);
+			}
+			return { iterator(this, pos.m_Pos, false), !pos.m_Found };
+		}
+	};
+}
\ No newline at end of file
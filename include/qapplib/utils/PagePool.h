@@ -19,21 +19,75 @@ along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <atomic>
 #include <bit>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <qapplib/Debug.h>
 #include "PageAllocator.h"
 
+// Define QAPP_PAGE_POOL_STATS (for the library and all its users alike) to have CPagePool count allocations,
+// frees, splits and merges per size class. Without it the counters and their updates compile out completely.
+#ifdef QAPP_PAGE_POOL_STATS
+	#define QAPP_PAGE_POOL_STAT(x) x
+#else
+	#define QAPP_PAGE_POOL_STAT(x)
+#endif
+
 namespace qapp
 {
+	struct SPagePoolStats
+	{
+		struct SSizeClass
+		{
+			unsigned char m_SizeBits = 0;
+			size_t m_Allocs = 0;          // Counters are only maintained with QAPP_PAGE_POOL_STATS
+			size_t m_Frees = 0;
+			size_t m_Splits = 0;          // Pages of this size class split into two halves
+			size_t m_Merges = 0;          // Pairs of buddies of this size class merged into one page
+			size_t m_Live = 0;            // Pages currently handed out
+			size_t m_PeakLive = 0;
+			size_t m_FreeListLength = 0;  // Pages in the shared free list (not counting thread caches)
+		};
+
+		size_t m_AllocatedBytes = 0;      // Bytes currently obtained from the page allocator
+		size_t m_PeakAllocatedBytes = 0;  // Only maintained with QAPP_PAGE_POOL_STATS
+		std::vector<SSizeClass> m_SizeClasses;
+	};
+
+	enum class EMemoryPressure
+	{
+		Soft,  // The soft limit of a pool budget was exceeded, or external memory pressure was reported
+		Hard,  // An allocation would exceed the hard limit of a pool budget and fails unless pages are freed
+	};
+
 	class CPagePool
 	{
 	public:
 		typedef void* handle_t;
+
+		typedef std::function<void(EMemoryPressure)> pressure_callback_t;
+
+		enum class EThreading
+		{
+			Single,      // Alloc/Free from one thread at a time, no synchronization
+			Concurrent,  // Alloc/Free from any thread, served from per-thread page caches
+		};
+
+		// In concurrent mode every size class has a small per-thread cache of free pages, refilled from and flushed
+		// to the shared free lists in batches. The shared free lists are guarded by one mutex rather than one per
+		// size class: splitting and merging buddies moves pages between size classes, so they can not be locked
+		// separately. Pages cached by a thread are not available to Trim and the idle limit until it flushes.
 		
-		CPagePool(IPageAllocator& page_allocator, unsigned char page_size_min_bits = 12);
+		CPagePool(IPageAllocator& page_allocator, unsigned char page_size_min_bits = 12, EThreading threading = EThreading::Single);
 		~CPagePool();
 
+		inline EThreading Threading() const { return m_Threading; }
+
 		inline unsigned char PageSizeMinBits() const { return m_PageSizeMinBits; }
 
 		inline unsigned char PageSizeMaxBits() const { return m_PageSizeMaxBits; }
@@ -48,8 +102,51 @@ namespace qapp
 
 		void Free(handle_t handle);
 
+		// Returns the pages cached by the calling thread to the shared free lists (no-op unless concurrent)
+		void FlushThreadCache();
+
+		// Releases fully free max pages to the page allocator until at most target_bytes are held from it. With
+		// decommit set, the fully free max pages that are kept have their memory handed back to the OS while
+		// their address range stays reserved. Returns the number of bytes released. Suitable for an idle timer.
+		size_t Trim(size_t target_bytes = 0, bool decommit = false);
+
+		// Splits and prefaults pages of the given size until the free list holds at least count of them (one more
+		// if the last split yields two), so that allocating them does not hit fresh memory. Pages already in the
+		// free list count towards count and are left alone.
+		void Reserve(unsigned char page_size_bits, size_t count);
+
+		// Reserves enough max pages to hold the given number of bytes
+		void Prewarm(size_t bytes);
+
+		// Prewarm on a background thread, only allowed in concurrent mode
+		std::future<void> PrewarmAsync(size_t bytes);
+
+		// Fully free max pages exceeding this many bytes are released to the page allocator as soon as they are freed
+		void SetIdleLimit(size_t idle_limit_bytes);
+
+		// Bytes currently obtained from the page allocator
+		size_t AllocatedBytes() const;
+
+		SPagePoolStats Stats() const;
+
+		// Limits the bytes obtained from the page allocator. Growing beyond the soft limit notifies the pressure
+		// callbacks after the allocation. An allocation that would exceed the hard limit notifies the callbacks
+		// first and throws std::bad_alloc if they did not free enough pages.
+		void SetBudget(size_t soft_limit_bytes, size_t hard_limit_bytes = SIZE_MAX);
+
+		// Callbacks run on the allocating (or NotifyPressure calling) thread with no pool lock held, so they may free pages
+		int AddPressureCallback(pressure_callback_t callback);
+
+		void RemovePressureCallback(int id);
+
+		// Invokes the pressure callbacks, e.g. from a CMemoryPressureMonitor
+		void NotifyPressure(EMemoryPressure pressure);
+
 		inline void* PtrFromHandle(handle_t handle) const { return (void*)(reinterpret_cast<uintptr_t>(handle) & ~PageSizeMask()); }
 
+		// Rebuilds the handle of an allocated page from its pointer and size
+		inline handle_t HandleFromPtr(void* ptr, unsigned char page_size_bits) const { return CreateHandle(ptr, page_size_bits); }
+
 		inline size_t PageSize(handle_t handle) const { return (size_t)1 << PageSizeBitsFromHandle(handle); }
 
 		inline static CPagePool& DefaultPagePool() { QAPP_ASSERT(s_DefaultPagePool); return *s_DefaultPagePool; }
@@ -57,21 +154,114 @@ namespace qapp
 		inline static void SetDefaultPagePool(CPagePool* page_pool) { s_DefaultPagePool = page_pool; }
 
 	private:
+		// Page obtained from IPageAllocator, split into smaller pages as a buddy tree. The tree nodes are numbered
+		// heap style: node 1 is the whole page, node n has the children 2n and 2n+1 and its buddy is n^1.
+		struct SMaxPage
+		{
+			void* m_Ptr = nullptr;
+			std::vector<uint64_t> m_FreeNodes;    // One bit per tree node, set while the node is in a free list
+			std::vector<uint32_t> m_FreeListPos;  // Free list position of each free node, indexed by the node's first min page
+			bool m_Decommitted = false;           // Fully free and decommitted with IPageAllocator::DecommitPage
+		};
+
+		struct SFreePage
+		{
+			handle_t  m_Handle;
+			SMaxPage* m_MaxPage;
+		};
+
+		struct SThreadCache;
+		struct SThreadCacheList;
+
+		static SThreadCacheList& ThreadCacheList();
+
+		SThreadCache& ThreadCache();
+
+		void FlushThreadCache(SThreadCache& cache, unsigned char size_index, size_t keep_count);
+
+		static size_t ThreadCacheCapacity(unsigned char page_size_bits);
+
+		std::unique_lock<std::mutex> LockIfConcurrent() const;
+
+		#ifdef QAPP_PAGE_POOL_STATS
+			struct SSizeClassCounters
+			{
+				std::atomic<size_t> m_Allocs = 0;
+				std::atomic<size_t> m_Frees = 0;
+				std::atomic<size_t> m_Splits = 0;
+				std::atomic<size_t> m_Merges = 0;
+				std::atomic<size_t> m_Live = 0;
+				std::atomic<size_t> m_PeakLive = 0;
+			};
+
+			void CountAlloc(unsigned char page_size_bits);
+
+			void CountFree(handle_t handle);
+		#endif
+
+		handle_t AllocUnchecked(unsigned char page_size_bits);
+
+		handle_t AllocUnderPressure(unsigned char page_size_bits, handle_t handle);
+
+		handle_t AllocCentral(unsigned char page_size_bits);
+
+		void FreeCentral(handle_t handle);
+
 		unsigned char SizeIndexFromSizeBits(unsigned char size_bits) const;
 		
 		unsigned char PageSizeBitsFromHandle(handle_t handle) const;
 
 		handle_t CreateHandle(void* ptr, unsigned char page_size_bits) const;
 
-		handle_t AllocInternal(unsigned char page_size_bits);
+		SFreePage AllocInternal(unsigned char page_size_bits);
+
+		// Allocates a new max page from the page allocator, within the budget
+		SFreePage AllocMaxPage();
+
+		void ReleaseMaxPage(SMaxPage& max_page);
+
+		// Reserve puts split pages back unmerged, so a max page can be entirely free but split. Merges such max pages
+		// into whole free max pages, so they can be trimmed and handed out again.
+		void MergeFreeMaxPages();
+
+		bool IsSubtreeFree(const SMaxPage& max_page, size_t node, unsigned char page_size_bits) const;
+
+		void RemoveFreeSubtree(SMaxPage& max_page, size_t node, unsigned char page_size_bits);
+
+		SMaxPage& MaxPageFromPtr(const void* ptr) const;
+
+		size_t NodeFromPtr(const SMaxPage& max_page, const void* ptr, unsigned char page_size_bits) const;
+
+		size_t MinPageIndexFromPtr(const SMaxPage& max_page, const void* ptr) const;
+
+		void PushFreePage(SMaxPage& max_page, void* ptr, unsigned char page_size_bits);
+
+		void RemoveFreePage(SMaxPage& max_page, void* ptr, unsigned char page_size_bits);
+
+		inline static bool TestNode(const SMaxPage& max_page, size_t node) { return (max_page.m_FreeNodes[node >> 6] >> (node & 63)) & 1; }
 
-		inline size_t PageSizeMask() const { return std::bit_ceil((uint8_t)(PageSizeMaxBits() - PageSizeMinBits())) - 1; }
+		inline size_t PageSizeMask() const { return std::bit_ceil((uint8_t)(PageSizeMaxBits() - PageSizeMinBits() + 1)) - 1; }
 
 		IPageAllocator&       m_PageAllocator;
 		const unsigned char   m_PageSizeMinBits;
 		const unsigned char   m_PageSizeMaxBits;
-		std::vector<void*>    m_AllocatedPages;  // Pages allocated from IPageAllocator that are used internally in this object (splitted into smaller pages)
-		std::vector<handle_t> m_FreePages[16];
+		const EThreading      m_Threading;
+		std::vector<std::unique_ptr<SMaxPage>> m_MaxPages;  // Pages allocated from IPageAllocator, sorted by address
+		std::vector<SFreePage> m_FreePages[16];
+		size_t                m_IdleLimit = SIZE_MAX;
+		bool                  m_HasUnmergedPages = false;  // Reserve has put back split pages without merging them
+		size_t                m_SoftLimit = SIZE_MAX;
+		size_t                m_HardLimit = SIZE_MAX;
+		std::atomic<bool>     m_SoftPressurePending = false;
+		std::mutex            m_CallbackMutex;
+		std::vector<std::pair<int, pressure_callback_t>> m_PressureCallbacks;
+		int                   m_LastPressureCallbackId = 0;
+		#ifdef QAPP_PAGE_POOL_STATS
+			SSizeClassCounters  m_Counters[16];
+			size_t              m_PeakAllocatedBytes = 0;  // Guarded like the free lists
+		#endif
+		mutable std::mutex    m_Mutex;           // Guards the free lists above in concurrent mode
+		std::vector<SThreadCache*> m_ThreadCaches;  // Thread caches holding pages of this pool (guarded by the thread cache registry mutex)
 
 		static CPagePool* s_DefaultPagePool;
 	};
@@ -0,0 +1,142 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include "PageBuffer.h"
+#include "PageSlab.h"
+
+namespace qapp
+{
+	// Byte sequence with O(log n) insert and erase anywhere, for documents too large to rewrite after every edit.
+	// The contents live in leaves of one pool page each, ordered by an implicit treap keyed by byte count. Small
+	// edits move bytes within a single leaf, larger ones split the tree at the edit and join it back.
+	class page_rope
+	{
+	public:
+		// leaf_size_bits 0 selects the min page size of the pool
+		page_rope(CPagePool& page_pool = CPagePool::DefaultPagePool(), unsigned char leaf_size_bits = 0);
+		~page_rope();
+
+		page_rope(page_rope&& other);
+
+		page_rope(const page_rope&) = delete;
+		page_rope& operator=(const page_rope&) = delete;
+
+		void clear();
+
+		inline size_t size() const { return m_Root ? m_Root->m_TreeSize : 0; }
+
+		inline bool empty() const { return 0 == size(); }
+
+		inline CPagePool& page_pool() const { return m_PagePool; }
+
+		void insert(size_t offset, const void* data, size_t size);
+
+		void append(const void* data, size_t size);
+
+		// Erases [offset, offset + size), clamped to the rope size
+		void erase(size_t offset, size_t size);
+
+		size_t read(size_t offset, void* buffer, size_t buffer_size) const;
+
+		// Same as page_buffer::find and page_buffer::count
+		size_t find(uint8_t byte, size_t offset = 0) const;
+		size_t find(const void* pattern, size_t pattern_size, size_t offset = 0) const;
+		size_t count(uint8_t byte, size_t offset = 0, size_t size = SIZE_MAX) const;
+
+		// Copies [offset, offset + size), clamped to the rope size, to a new rope on the same pool
+		page_rope substr(size_t offset, size_t size) const;
+
+		// Same as page_buffer::for_each_segment
+		template <class TLambda>
+		void for_each_segment(size_t offset, size_t size, TLambda&& fn) const;
+
+	private:
+		struct node
+		{
+			node* m_Left = nullptr;
+			node* m_Right = nullptr;
+			uint32_t m_Priority = 0;
+			uint32_t m_Size = 0;  // Bytes in this leaf
+			size_t m_TreeSize = 0;  // Bytes in this subtree
+			CPagePool::handle_t m_Leaf = CPagePool::handle_t();
+		};
+
+		inline static size_t tree_size(const node* n) { return n ? n->m_TreeSize : 0; }
+
+		inline static void update(node* n) { n->m_TreeSize = tree_size(n->m_Left) + n->m_Size + tree_size(n->m_Right); }
+
+		inline char* leaf_ptr(const node* n) const { return (char*)m_PagePool.PtrFromHandle(n->m_Leaf); }
+
+		inline size_t leaf_size() const { return CPagePool::SizeFromBits(m_LeafSizeBits); }
+
+		node* new_leaf(const void* data, size_t size);
+
+		void free_tree(node* n);
+
+		node* find_leaf(size_t& offset, ptrdiff_t tree_size_delta);
+
+		node* merge(node* a, node* b);
+
+		void split(node* n, size_t offset, node*& ret_left, node*& ret_right);
+
+		node* join(node* a, node* b);
+
+		template <class TLambda>
+		bool for_each_segment(const node* n, size_t beg, size_t end, TLambda& fn) const;
+
+		CPagePool& m_PagePool;
+		unsigned char m_LeafSizeBits;
+		std::unique_ptr<page_slab<node>> m_Nodes;
+		node* m_Root = nullptr;
+		uint32_t m_Seed = 0x9E3779B9;  // For node priorities
+	};
+
+	template <class TLambda>
+	void page_rope::for_each_segment(size_t offset, size_t size, TLambda&& fn) const
+	{
+		if (offset >= this->size() || !size)
+			return;
+		for_each_segment(m_Root, offset, offset + std::min(size, this->size() - offset), fn);
+	}
+
+	template <class TLambda>
+	bool page_rope::for_each_segment(const node* n, size_t beg, size_t end, TLambda& fn) const
+	{
+		// [beg, end) is relative to the subtree of n and not empty
+		const auto leaf_beg = tree_size(n->m_Left);
+		const auto leaf_end = leaf_beg + n->m_Size;
+		if (beg < leaf_beg && !for_each_segment(n->m_Left, beg, std::min(end, leaf_beg), fn))
+			return false;
+		if (beg < leaf_end && end > leaf_beg)
+		{
+			const auto seg_beg = std::max(beg, leaf_beg);
+			const auto seg_end = std::min(end, leaf_end);
+			if (!page_buffer::invoke_segment_fn(fn, (const void*)(leaf_ptr(n) + (seg_beg - leaf_beg)), seg_end - seg_beg))
+				return false;
+		}
+		if (end > leaf_end)
+			return for_each_segment(n->m_Right, beg > leaf_end ? beg - leaf_end : 0, end - leaf_end, fn);
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <utility>
+#include "PagePool.h"
+
+namespace qapp
+{
+	// Fixed size slot allocator carving pool pages into slots. Freed slots are kept in an intrusive free list and
+	// reused first, so alloc and free are O(1) in any order. Pages grow geometrically up to the max page size and
+	// are returned to the pool on clear() or destruction only.
+	class page_slab_base
+	{
+	public:
+		page_slab_base(CPagePool& page_pool, size_t slot_size, size_t slot_alignment);
+		~page_slab_base();
+
+		page_slab_base(const page_slab_base&) = delete;
+		page_slab_base& operator=(const page_slab_base&) = delete;
+
+		// Returns all pages to the pool, objects still allocated are not destroyed
+		void clear();
+
+		inline void* alloc()
+		{
+			if (m_FreeList)
+			{
+				auto* slot = m_FreeList;
+				m_FreeList = *(void**)slot;
+				return slot;
+			}
+			if (m_Cur == m_End)
+				add_page();
+			auto* slot = m_Cur;
+			m_Cur += m_SlotSize;
+			return slot;
+		}
+
+		inline void free(void* slot)
+		{
+			*(void**)slot = m_FreeList;
+			m_FreeList = slot;
+		}
+
+		inline size_t slot_size() const { return m_SlotSize; }
+
+	private:
+		void add_page();
+
+		CPagePool& m_PagePool;
+		const size_t m_SlotSize;
+		void* m_FreeList = nullptr;
+		char* m_Cur = nullptr;  // Unused part of the last page
+		char* m_End = nullptr;
+		std::vector<CPagePool::handle_t> m_Pages;
+	};
+
+	template <class T>
+	class page_slab : public page_slab_base
+	{
+	public:
+		page_slab(CPagePool& page_pool = CPagePool::DefaultPagePool())
+			: page_slab_base(page_pool, sizeof(T), alignof(T)) {}
+
+		template <typename... TArgs>
+		inline T* New(TArgs&&... args) { return new (alloc()) T(std::forward<TArgs>(args)...); }
+
+		inline void Delete(T* obj)
+		{
+			obj->~T();
+			free(obj);
+		}
+	};
+}
\ No newline at end of file
@@ -19,6 +19,8 @@ along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <type_traits>
+
 #include "PagePool.h"
 
 namespace qapp
@@ -30,6 +32,7 @@ namespace qapp
 		template <typename... TArgs>
 		inline allocator_utils(TArgs&&... args) : TBase(std::forward<TArgs>(args)...) {}
 
+		// Objects with a non-trivial destructor are destroyed by the allocator, see page_stack_allocator_base::push_finalizer
 		template <class T, typename... TArgs>
 		inline T* New(TArgs&&... args);
 	};
@@ -38,7 +41,17 @@ namespace qapp
 	template <class T, typename... TArgs>
 	T* allocator_utils<TBase>::New(TArgs&&... args)
 	{
-		return new (TBase::alloc(sizeof(T), alignof(T))) T(std::forward<TArgs>(args)...);
+		if constexpr (std::is_trivially_destructible_v<T>)
+		{
+			return new (TBase::alloc(sizeof(T), alignof(T))) T(std::forward<TArgs>(args)...);
+		}
+		else
+		{
+			auto* finalizer = TBase::alloc_finalizer();
+			auto* obj = new (TBase::alloc(sizeof(T), alignof(T))) T(std::forward<TArgs>(args)...);
+			TBase::push_finalizer(finalizer, obj, [](void* p) { ((T*)p)->~T(); });
+			return obj;
+		}
 	}
 
 	class page_stack_allocator_base
@@ -46,18 +59,44 @@ namespace qapp
 	public:
 		typedef unsigned long long state_t;
 
+		typedef void (*finalize_fn_t)(void* obj);
+
+		struct finalizer;
+
 		page_stack_allocator_base(CPagePool& page_pool);
 		~page_stack_allocator_base();
 
 		void clear();
 
+		// Allocations larger than the max page size are mapped from the OS and unwound by restore and clear like pages
 		void* alloc(size_t size, size_t alignment);
 
 		state_t state();
 
+		// Bytes allocated since the last clear, including alignment padding, unused tails of filled pages and
+		// allocations larger than the max page size
+		size_t used_bytes() const;
+
+		// Bytes of pool pages held
+		inline size_t page_bytes() const { return m_PageBytes; }
+
+		// Destroys the objects allocated since s, see push_finalizer, and frees their memory
 		void restore(state_t s);
 
+		// Allocates a finalizer record in the arena, to be passed to push_finalizer. Allocate it before the object.
+		finalizer* alloc_finalizer();
+
+		// Registers fn(obj) to run when the allocator is restored to a state before the finalizer allocation or
+		// cleared. Finalizers run in reverse order of registration while the memory is still valid.
+		void push_finalizer(finalizer* f, void* obj, finalize_fn_t fn);
+
 	private:
+		struct large_block;
+
+		void run_finalizers(state_t s);
+
+		void* alloc_large(size_t size, size_t alignment);
+
 		inline void* last_page_ptr();
 
 		void add_page(size_t min_size);
@@ -69,6 +108,9 @@ namespace qapp
 		CPagePool& m_PagePool;
 		unsigned int m_LastPageUsage = 0;
 		std::vector<CPagePool::handle_t> m_Pages;
+		finalizer* m_Finalizers = nullptr;  // Last registered finalizer, linked to the previous ones
+		size_t m_PageBytes = 0;
+		size_t m_LargeBytes = 0;  // Bytes of allocations larger than the max page size
 	};
 
 	class page_stack_allocator : public allocator_utils<page_stack_allocator_base> 
@@ -0,0 +1,373 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <qapplib/Debug.h>
+
+#include "Bits.h"
+#include "PageBuffer.h"
+
+namespace qapp
+{
+	// Vector on pool pages. Elements live in chained pages of doubling size (see page_buffer_layout, counted in units
+	// of a fixed number of elements), so growing never moves elements and pointers to elements stay valid until the
+	// element is erased. A unit is as many elements as fill the smallest page, which for element sizes that are not
+	// a power of two is picked to hold at least 8 of them, so less than an eighth of each page is left unused.
+	template <class T>
+	class page_vector
+	{
+	public:
+		typedef T value_type;
+		typedef size_t size_type;
+
+		template <bool IsConst>
+		class basic_iterator;
+
+		typedef basic_iterator<false> iterator;
+		typedef basic_iterator<true> const_iterator;
+
+		page_vector(CPagePool& page_pool = CPagePool::DefaultPagePool());
+		~page_vector();
+
+		page_vector(page_vector&& other);
+
+		page_vector(const page_vector&) = delete;
+		page_vector& operator=(const page_vector&) = delete;
+
+		// Destroys all elements and returns all pages to the pool
+		void clear();
+
+		inline bool empty() const { return 0 == m_Size; }
+
+		inline size_t size() const { return m_Size; }
+
+		inline size_t capacity() const { return m_Capacity; }
+
+		inline CPagePool& page_pool() const { return m_PagePool; }
+
+		void reserve(size_t capacity);
+
+		// New elements are value initialized
+		void resize(size_t size);
+
+		void resize(size_t size, const T& value);
+
+		template <typename... TArgs>
+		inline T& emplace_back(TArgs&&... args);
+
+		inline void push_back(const T& value) { emplace_back(value); }
+
+		inline void push_back(T&& value) { emplace_back(std::move(value)); }
+
+		inline void pop_back();
+
+		inline T& operator[](size_t index) { return *element_ptr(index); }
+
+		inline const T& operator[](size_t index) const { return *element_ptr(index); }
+
+		inline T& front() { return (*this)[0]; }
+
+		inline const T& front() const { return (*this)[0]; }
+
+		inline T& back() { return (*this)[m_Size - 1]; }
+
+		inline const T& back() const { return (*this)[m_Size - 1]; }
+
+		inline iterator begin() { return iterator(this, 0); }
+
+		inline iterator end() { return iterator(this, m_Size); }
+
+		inline const_iterator begin() const { return const_iterator(this, 0); }
+
+		inline const_iterator end() const { return const_iterator(this, m_Size); }
+
+		// Calls fn(T* elements, size_t count) for each contiguous run of [index, index + count), clamped to the size
+		template <class TLambda>
+		void for_each_segment(size_t index, size_t count, TLambda&& fn);
+
+		// Calls fn(const T* elements, size_t count), same as above
+		template <class TLambda>
+		void for_each_segment(size_t index, size_t count, TLambda&& fn) const;
+
+	private:
+		inline T* element_ptr(size_t index) const
+		{
+			QAPP_ASSERT(index < m_Size);
+			return slot_ptr(index);
+		}
+
+		// Storage of an element, also past the size
+		inline T* slot_ptr(size_t index) const
+		{
+			size_t page_index, page_offset;
+			locate(index, page_index, page_offset);
+			return m_Pages[page_index] + page_offset;
+		}
+
+		inline void locate(size_t index, size_t& ret_page_index, size_t& ret_page_offset) const
+		{
+			// Units hold a power of two number of elements exactly when the element size is a power of two
+			size_t unit, unit_offset;
+			if constexpr (std::has_single_bit(sizeof(T)))
+			{
+				unit = index >> m_UnitElementsBits;
+				unit_offset = index & (m_UnitElements - 1);
+			}
+			else
+			{
+				// Multiplying by the reciprocal is exact for indices below 2^32, divide beyond
+				unit = index <= m_UnitReciprocalLimit ? (size_t)mul_hi64(m_UnitReciprocal, index) : index / m_UnitElements;
+				unit_offset = index - unit * m_UnitElements;
+			}
+			m_Layout.locate(unit, ret_page_index, ret_page_offset);
+			ret_page_offset = ret_page_offset * m_UnitElements + unit_offset;
+		}
+
+		inline size_t page_elements(size_t page_index) const { return m_Layout.page_size(page_index) * m_UnitElements; }
+
+		inline unsigned char page_size_bits(size_t page_index) const
+		{
+			return m_UnitPageSizeBits + (unsigned char)std::countr_zero(m_Layout.page_size(page_index));
+		}
+
+		void add_page();
+
+		void destroy_from(size_t index);
+
+		CPagePool& m_PagePool;
+		page_buffer_layout m_Layout;  // Counted in units
+		size_t m_UnitElements = 1;
+		unsigned char m_UnitElementsBits = 0;  // Only used for power of two element sizes
+		uint64_t m_UnitReciprocal = 0;  // 2^64 / m_UnitElements rounded up, only used for other element sizes
+		size_t m_UnitReciprocalLimit = 0;  // Highest index m_UnitReciprocal is used for
+		unsigned char m_UnitPageSizeBits = 0;  // Pool page of one unit
+		std::vector<T*> m_Pages;
+		size_t m_Size = 0;
+		size_t m_Capacity = 0;
+	};
+
+	template <class T>
+	template <bool IsConst>
+	class page_vector<T>::basic_iterator
+	{
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef ptrdiff_t difference_type;
+		typedef std::conditional_t<IsConst, const T*, T*> pointer;
+		typedef std::conditional_t<IsConst, const T&, T&> reference;
+		typedef std::conditional_t<IsConst, const page_vector*, page_vector*> vector_pointer;
+
+		basic_iterator() = default;
+
+		inline basic_iterator(vector_pointer vector, size_t index) : m_Vector(vector), m_Index(index) {}
+
+		inline operator basic_iterator<true>() const { return basic_iterator<true>(m_Vector, m_Index); }
+
+		inline size_t index() const { return m_Index; }
+
+		inline reference operator*() const { return (*m_Vector)[m_Index]; }
+
+		inline pointer operator->() const { return &(*m_Vector)[m_Index]; }
+
+		inline reference operator[](difference_type n) const { return (*m_Vector)[m_Index + n]; }
+
+		inline basic_iterator& operator++() { ++m_Index; return *this; }
+
+		inline basic_iterator operator++(int) { auto it = *this; ++m_Index; return it; }
+
+		inline basic_iterator& operator--() { --m_Index; return *this; }
+
+		inline basic_iterator operator--(int) { auto it = *this; --m_Index; return it; }
+
+		inline basic_iterator& operator+=(difference_type n) { m_Index += n; return *this; }
+
+		inline basic_iterator& operator-=(difference_type n) { m_Index -= n; return *this; }
+
+		inline basic_iterator operator+(difference_type n) const { return basic_iterator(m_Vector, m_Index + n); }
+
+		inline friend basic_iterator operator+(difference_type n, const basic_iterator& it) { return it + n; }
+
+		inline basic_iterator operator-(difference_type n) const { return basic_iterator(m_Vector, m_Index - n); }
+
+		inline difference_type operator-(const basic_iterator& other) const { return (difference_type)m_Index - (difference_type)other.m_Index; }
+
+		inline bool operator==(const basic_iterator& other) const { return m_Index == other.m_Index; }
+
+		inline auto operator<=>(const basic_iterator& other) const { return m_Index <=> other.m_Index; }
+
+	private:
+		vector_pointer m_Vector = nullptr;
+		size_t m_Index = 0;
+	};
+
+	template <class T>
+	page_vector<T>::page_vector(CPagePool& page_pool)
+		: m_PagePool(page_pool)
+	{
+		static_assert(sizeof(T) > 0);
+		QAPP_ASSERT(alignof(T) <= page_pool.PageSizeMin());
+		QAPP_ASSERT(sizeof(T) <= page_pool.PageSizeMax());
+		const size_t unit_elements_min = std::has_single_bit(sizeof(T)) ? 1 : 8;
+		const auto unit_page_size = std::clamp(std::bit_ceil(unit_elements_min * sizeof(T)), page_pool.PageSizeMin(), page_pool.PageSizeMax());
+		m_UnitElements = unit_page_size / sizeof(T);
+		m_UnitElementsBits = (unsigned char)std::countr_zero(m_UnitElements);
+		if (m_UnitElements > 1)
+		{
+			m_UnitReciprocal = UINT64_MAX / m_UnitElements + 1;
+			m_UnitReciprocalLimit = UINT32_MAX;
+		}
+		m_UnitPageSizeBits = (unsigned char)std::countr_zero(unit_page_size);
+		m_Layout.m_PageSizeBits = 0;
+		m_Layout.m_PageSizeMaxBits = page_pool.PageSizeMaxBits() - m_UnitPageSizeBits;
+		m_Layout.m_Chained = true;
+	}
+
+	template <class T>
+	page_vector<T>::~page_vector()
+	{
+		clear();
+	}
+
+	template <class T>
+	page_vector<T>::page_vector(page_vector&& other)
+		: m_PagePool(other.m_PagePool)
+		, m_Layout(other.m_Layout)
+		, m_UnitElements(other.m_UnitElements)
+		, m_UnitElementsBits(other.m_UnitElementsBits)
+		, m_UnitReciprocal(other.m_UnitReciprocal)
+		, m_UnitReciprocalLimit(other.m_UnitReciprocalLimit)
+		, m_UnitPageSizeBits(other.m_UnitPageSizeBits)
+		, m_Pages(std::move(other.m_Pages))
+		, m_Size(other.m_Size)
+		, m_Capacity(other.m_Capacity)
+	{
+		other.m_Pages.clear();
+		other.m_Size = 0;
+		other.m_Capacity = 0;
+	}
+
+	template <class T>
+	void page_vector<T>::clear()
+	{
+		destroy_from(0);
+		for (size_t i = 0; i < m_Pages.size(); ++i)
+			m_PagePool.Free(m_PagePool.HandleFromPtr(m_Pages[i], page_size_bits(i)));
+		m_Pages.clear();
+		m_Capacity = 0;
+	}
+
+	template <class T>
+	void page_vector<T>::reserve(size_t capacity)
+	{
+		while (m_Capacity < capacity)
+			add_page();
+	}
+
+	template <class T>
+	void page_vector<T>::resize(size_t size)
+	{
+		if (size <= m_Size)
+			return destroy_from(size);
+		reserve(size);
+		while (m_Size < size)
+			emplace_back();
+	}
+
+	template <class T>
+	void page_vector<T>::resize(size_t size, const T& value)
+	{
+		if (size <= m_Size)
+			return destroy_from(size);
+		reserve(size);
+		while (m_Size < size)
+			emplace_back(value);
+	}
+
+	template <class T>
+	template <typename... TArgs>
+	inline T& page_vector<T>::emplace_back(TArgs&&... args)
+	{
+		if (m_Size == m_Capacity)
+			add_page();
+		auto* element = new (slot_ptr(m_Size)) T(std::forward<TArgs>(args)...);
+		++m_Size;
+		return *element;
+	}
+
+	template <class T>
+	inline void page_vector<T>::pop_back()
+	{
+		QAPP_ASSERT(m_Size);
+		back().~T();
+		--m_Size;
+	}
+
+	template <class T>
+	template <class TLambda>
+	void page_vector<T>::for_each_segment(size_t index, size_t count, TLambda&& fn)
+	{
+		std::as_const(*this).for_each_segment(index, count, [&](const T* elements, size_t n) { fn(const_cast<T*>(elements), n); });
+	}
+
+	template <class T>
+	template <class TLambda>
+	void page_vector<T>::for_each_segment(size_t index, size_t count, TLambda&& fn) const
+	{
+		if (index >= m_Size)
+			return;
+		count = std::min(count, m_Size - index);
+		size_t page_index, page_offset;
+		locate(index, page_index, page_offset);
+		while (count)
+		{
+			const auto n = std::min(page_elements(page_index) - page_offset, count);
+			fn((const T*)m_Pages[page_index] + page_offset, n);
+			count -= n;
+			++page_index;
+			page_offset = 0;
+		}
+	}
+
+	template <class T>
+	void page_vector<T>::add_page()
+	{
+		const auto page_index = m_Pages.size();
+		m_Pages.push_back((T*)m_PagePool.PtrFromHandle(m_PagePool.Alloc(page_size_bits(page_index))));
+		m_Capacity += page_elements(page_index);
+	}
+
+	template <class T>
+	void page_vector<T>::destroy_from(size_t index)
+	{
+		if constexpr (!std::is_trivially_destructible_v<T>)
+			for_each_segment(index, m_Size - std::min(index, m_Size), [](T* elements, size_t n) { std::destroy_n(elements, n); });
+		m_Size = std::min(index, m_Size);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+#include <qapplib/Debug.h>
+
+#include "MemoryResource.h"
+#include "PageStackAllocator.h"
+
+namespace qapp
+{
+	struct scratch_arena_stats
+	{
+		size_t   m_UsedBytes = 0;      // Bytes in use by the open frames, see page_stack_allocator_base::used_bytes
+		size_t   m_PeakUsedBytes = 0;  // Highest m_UsedBytes seen when closing a frame
+		size_t   m_PageBytes = 0;      // Bytes of pool pages held by the arena
+		unsigned m_FrameDepth = 0;     // Open frames
+	};
+
+	// Per-thread page_stack_allocator for temporary allocations, used through scratch_frame. The arenas of all
+	// threads share one concurrent page pool owned by the library.
+	struct scratch_arena
+	{
+		scratch_arena();
+
+		// The arena of the calling thread
+		static scratch_arena& current();
+
+		page_stack_allocator m_Allocator;
+		page_stack_resource  m_Memory;
+		unsigned             m_Depth = 0;
+		size_t               m_PeakUsedBytes = 0;
+	};
+
+	// The concurrent page pool shared by the scratch arenas of all threads, also for other short lived buffers
+	CPagePool& scratch_page_pool();
+
+	// Usage of the scratch arena of the calling thread
+	scratch_arena_stats scratch_stats();
+
+	// Scope of temporary allocations from the scratch arena of the calling thread. Destroying the frame destroys the
+	// objects created with New and releases everything allocated through the frame. Frames nest, but only the
+	// innermost frame of a thread may allocate and frames must be destroyed in reverse order, as on the stack.
+	class scratch_frame
+	{
+	public:
+		scratch_frame();
+		~scratch_frame();
+
+		scratch_frame(const scratch_frame&) = delete;
+		scratch_frame& operator=(const scratch_frame&) = delete;
+
+		inline void* alloc(size_t size, size_t alignment = alignof(std::max_align_t))
+		{
+			QAPP_ASSERT(m_Depth == m_Arena.m_Depth);
+			return m_Arena.m_Allocator.alloc(size, alignment);
+		}
+
+		template <class T>
+		inline T* alloc_array(size_t count) { return (T*)alloc(count * sizeof(T), alignof(T)); }
+
+		template <class T, typename... TArgs>
+		inline T* New(TArgs&&... args)
+		{
+			QAPP_ASSERT(m_Depth == m_Arena.m_Depth);
+			return m_Arena.m_Allocator.New<T>(std::forward<TArgs>(args)...);
+		}
+
+		// For std::pmr containers not outliving the frame
+		inline std::pmr::memory_resource& memory() { return m_Arena.m_Memory; }
+
+	private:
+		scratch_arena& m_Arena;
+		const page_stack_allocator::state_t m_State;
+		const unsigned m_Depth;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifdef __linux__
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "FilePageAllocator.h"
+#include "PageBuffer.h"
+#include "PageBufferStream.h"
+
+namespace qapp
+{
+	// Page allocator backed by a memfd, for page_buffers whose contents are handed to other processes without
+	// copying. The other process gets the file descriptor (over a Unix domain socket with SCM_RIGHTS, or by
+	// opening /proc/<pid>/fd/<fd>) together with a shared_page_buffer_desc and maps the pages read-only.
+	class CSharedPageAllocator : public CFilePageAllocator
+	{
+	public:
+		CSharedPageAllocator(size_t page_size, size_t region_size = (size_t)1 << 30)
+			: CFilePageAllocator(page_size, std::string(), region_size) {}
+	};
+
+	// Process independent description of a page_buffer, its pages given by their offsets in the shared file
+	struct shared_page_buffer_desc
+	{
+		struct SPage
+		{
+			uint64_t m_FileOffset = 0;
+			uint64_t m_Size = 0;
+		};
+
+		uint64_t m_Size = 0;
+		std::vector<SPage> m_Pages;
+	};
+
+	// Describes the pages of a snapshot of a page_buffer allocated from a pool using the given allocator. The snapshot
+	// must stay alive for as long as other processes read from it, writes to the buffer meanwhile go to copies of
+	// the shared pages and don't show in their views.
+	shared_page_buffer_desc export_shared(const page_buffer_snapshot& snapshot, const CFilePageAllocator& allocator);
+
+	void write_shared_desc(std::ostream& out, const shared_page_buffer_desc& desc);
+
+	shared_page_buffer_desc read_shared_desc(std::istream& in);
+
+	// Read-only view of a page_buffer exported by another process, mapping the shared file instead of copying
+	class shared_page_buffer_view
+	{
+	public:
+		shared_page_buffer_view(int fd, const shared_page_buffer_desc& desc);
+		~shared_page_buffer_view();
+
+		shared_page_buffer_view(const shared_page_buffer_view&) = delete;
+		shared_page_buffer_view& operator=(const shared_page_buffer_view&) = delete;
+
+		inline size_t size() const { return m_Size; }
+
+		inline bool empty() const { return 0 == size(); }
+
+		size_t read(size_t offset, void* buffer, size_t buffer_size) const;
+
+		// Same as page_buffer::find and page_buffer::count
+		size_t find(uint8_t byte, size_t offset = 0) const;
+		size_t find(const void* pattern, size_t pattern_size, size_t offset = 0) const;
+		size_t count(uint8_t byte, size_t offset = 0, size_t size = SIZE_MAX) const;
+
+		// Same as page_buffer::for_each_segment, the segments point into the mapped pages
+		template <class TLambda>
+		void for_each_segment(size_t offset, size_t size, TLambda&& fn) const;
+
+	private:
+		size_t page_index_at(size_t offset) const;
+
+		const char* m_Mapping = nullptr;
+		size_t m_MappingSize = 0;
+		size_t m_Size = 0;
+		std::vector<const char*> m_PagePtrs;
+		std::vector<size_t> m_PageEnds;  // Buffer offset of the end of each page
+	};
+
+	typedef basic_page_istream<shared_page_buffer_view> shared_page_buffer_istream;
+
+	template <class TLambda>
+	void shared_page_buffer_view::for_each_segment(size_t offset, size_t size, TLambda&& fn) const
+	{
+		if (offset >= this->size())
+			return;
+		const auto end = offset + std::min(size, this->size() - offset);
+		for (auto page_index = page_index_at(offset); offset < end; ++page_index)
+		{
+			const auto page_beg = page_index ? m_PageEnds[page_index - 1] : 0;
+			const auto n = std::min(m_PageEnds[page_index], end) - offset;
+			if (!page_buffer::invoke_segment_fn(fn, (const void*)(m_PagePtrs[page_index] + (offset - page_beg)), n))
+				return;
+			offset += n;
+		}
+	}
+}
+
+#endif
\ No newline at end of file
@@ -23,6 +23,8 @@ along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 #include <QtCore/qvariant.h>
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <ranges>
@@ -152,10 +154,29 @@ namespace qapp
 		}
 	}
 
+	// Buffer of for_each_line on pages of the scratch page pool. Not taken from a scratch_frame, which would release
+	// whatever the callback allocates from outer frames of the same thread when closed.
+	class CLineBuffer
+	{
+	public:
+		explicit CLineBuffer(size_t size);
+		~CLineBuffer();
+
+		CLineBuffer(const CLineBuffer&) = delete;
+		CLineBuffer& operator=(const CLineBuffer&) = delete;
+
+		inline char* Data() const { return m_Data; }
+
+	private:
+		char*  m_Data = nullptr;
+		size_t m_Size = 0;
+	};
+
 	template <class TLambda>
 	void for_each_line(std::istream& in, size_t max_line_length, TLambda&& lambda)
 	{
-		auto* buf = (char*)alloca(max_line_length + 1);
+		CLineBuffer line_buffer(max_line_length + 1);
+		auto* buf = line_buffer.Data();
 		char* end = buf;
 		for (;;)
 		{
@@ -292,6 +313,10 @@ namespace qapp
 		public:
 			streambuf(const void* beg, const void* end) { setg((char*)beg, (char*)beg, (char*)end); }
 
+			std::streamoff find(const void* pattern, size_t pattern_size) const;
+
+			size_t count(uint8_t byte) const;
+
 		protected:
 			std::streamsize xsgetn(char* s, std::streamsize n) override
 			{
@@ -339,6 +364,14 @@ namespace qapp
 	public:
 		imemstream(const void* beg, const void* end) : std::istream(&m_StreamBuf), m_StreamBuf(beg, end) {}
 
+		// Return the stream position of the first occurrence at or after the read position, or -1. The read
+		// position is left unchanged.
+		inline std::streamoff find(uint8_t byte) const { return m_StreamBuf.find(&byte, 1); }
+		inline std::streamoff find(const void* pattern, size_t pattern_size) const { return m_StreamBuf.find(pattern, pattern_size); }
+
+		// Returns the number of occurrences of byte from the read position on
+		inline size_t count(uint8_t byte) const { return m_StreamBuf.count(byte); }
+
 	private:
 		streambuf m_StreamBuf;
 	};
@@ -19,6 +19,7 @@ along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <cstddef>
 #include <string_view>
 #include <QtCore/qstring.h>
 
@@ -28,4 +29,43 @@ namespace qapp
 	{
 		return std::wstring_view((const wchar_t*)s.data(), s.length()); 
 	}
+
+	// Encodes UTF-16 as UTF-8 into dst, which needs room for 3 bytes per code unit. Unpaired surrogates are
+	// encoded as U+FFFD. Returns the number of bytes written.
+	inline size_t utf16_to_utf8(const char16_t* src, size_t size, char* dst)
+	{
+		auto* out = (unsigned char*)dst;
+		for (size_t i = 0; i < size; ++i)
+		{
+			char32_t c = src[i];
+			if (c < 0x80)
+			{
+				*out++ = (unsigned char)c;
+				continue;
+			}
+			if (c < 0x800)
+			{
+				*out++ = (unsigned char)(0xC0 | (c >> 6));
+				*out++ = (unsigned char)(0x80 | (c & 0x3F));
+				continue;
+			}
+			if (c >= 0xD800 && c < 0xE000)
+			{
+				if (c < 0xDC00 && i + 1 < size && src[i + 1] >= 0xDC00 && src[i + 1] < 0xE000)
+				{
+					c = 0x10000 + ((c - 0xD800) << 10) + (src[++i] - 0xDC00);
+					*out++ = (unsigned char)(0xF0 | (c >> 18));
+					*out++ = (unsigned char)(0x80 | ((c >> 12) & 0x3F));
+					*out++ = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+					*out++ = (unsigned char)(0x80 | (c & 0x3F));
+					continue;
+				}
+				c = 0xFFFD;
+			}
+			*out++ = (unsigned char)(0xE0 | (c >> 12));
+			*out++ = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+			*out++ = (unsigned char)(0x80 | (c & 0x3F));
+		}
+		return out - (unsigned char*)dst;
+	}
 }
\ No newline at end of file
@@ -28,6 +28,8 @@ along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 #include <qapplib/actions/ActionManager.hpp>
 #include <qapplib/actions/StandardActions.h>
 #include <qapplib/utils/PathUtils.h>
+#include <qapplib/utils/ScratchArena.h>
+#include <qapplib/utils/StringUtils.h>
 #include <qapplib/UiUtils.h>
 #include <qapplib/Document.hpp>
 #include <qapplib/DocumentManager.hpp>
@@ -55,12 +57,11 @@ namespace qapp
 		return QDir::toNativeSeparators(QDir::cleanPath(path));
 	}
 
-	// TODO: Improve by removing the extra allocation here
 	static std::string ToUtf8String(const QString& s)
 	{
-		auto utf8Data = s.toUtf8();
-		std::string_view utf8_string_view(utf8Data.constData(), utf8Data.size());
-		return std::string(utf8_string_view);
+		scratch_frame frame;
+		auto* utf8 = frame.alloc_array<char>((size_t)s.size() * 3);
+		return std::string(utf8, utf16_to_utf8((const char16_t*)s.utf16(), s.size(), utf8));
 	}
 
 	CWorkbench::CWorkbench(CDocumentManager& document_manager, CActionManager& action_manager, QSettings& settings)
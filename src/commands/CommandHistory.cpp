@@ -30,6 +30,7 @@ namespace qapp
 		: m_Editor(editor)
 		, m_DataBuffer(page_pool)
 		, m_Allocator(page_pool)
+		, m_Memory(m_Allocator)
 	{
 	}
 
@@ -38,6 +39,11 @@ namespace qapp
 		FreeAll();
 	}
 
+	void CCommandHistory::SetDataCompression(size_t idle_operations)
+	{
+		m_DataBuffer.set_compression(idle_operations);
+	}
+
 	void CCommandHistory::Clear()
 	{
 		FreeAll();
@@ -103,7 +109,7 @@ namespace qapp
 	{
 		if (!m_RedoStack)
 			return;
-		FreeCommandList(m_RedoStack);
+		ForgetCleanPoint(m_RedoStack);
 		m_Allocator.restore(m_RedoStack->m_AllocatorState);
 		m_RedoStack = nullptr;
 		m_DataBuffer.resize(m_DataBufferPos);
@@ -139,39 +145,26 @@ namespace qapp
 		cmd.m_Command->Undo(ctx_exec);
 	}
 
-	void CCommandHistory::FreeCommandList(SCommand* front)
+	void CCommandHistory::ForgetCleanPoint(const SCommand* front)
 	{
-		while (front)
+		for (; front; front = front->m_Next)
 		{
-			auto* tmp = front;
-			front = tmp->m_Next;
-			FreeCommand(*tmp);
+			if (front == m_CleanPoint)
+			{
+				m_CleanPoint = NO_CLEAN_POINT;
+			}
 		}
 	}
 
-	void CCommandHistory::FreeCommand(SCommand& cmd)
-	{
-		if (&cmd == m_CleanPoint)
-		{
-			m_CleanPoint = NO_CLEAN_POINT;
-		}
-		cmd.~SCommand();
-	}
-
-	CCommandHistory::SCommand::~SCommand()
-	{
-		if (m_Command)
-			m_Command->~ICommand();
-	}
-
 	void CCommandHistory::FreeAll()
 	{
-		FreeCommandList(m_RedoStack);
+		ForgetCleanPoint(m_RedoStack);
 		m_RedoStack = nullptr;
-		FreeCommandList(m_UndoStack);
+		ForgetCleanPoint(m_UndoStack);
 		m_UndoStack = nullptr;
 		m_Allocator.clear();
 		m_DataBuffer.clear();
+		m_DataBuffer.shrink_to_fit();
 		m_DataBufferPos = 0;
 	}
 
@@ -0,0 +1,227 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <bit>
+#include <cstring>
+#include <qapplib/utils/ByteSearch.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__)) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define QAPP_BYTE_SEARCH_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define QAPP_TARGET_AVX2
+	#else
+		#define QAPP_TARGET_AVX2 __attribute__((target("avx2,popcnt,bmi")))
+	#endif
+#endif
+
+namespace qapp
+{
+	// Scalar
+
+	static const uint8_t* find_byte_scalar(const uint8_t* p, const uint8_t* end, uint8_t byte)
+	{
+		if (p == end)
+			return nullptr;
+		return (const uint8_t*)memchr(p, byte, end - p);
+	}
+
+	static const uint8_t* find_pattern_scalar(const uint8_t* p, const uint8_t* end, const uint8_t* pattern, size_t pattern_size)
+	{
+		if ((size_t)(end - p) < pattern_size)
+			return nullptr;
+		const auto* last = end - pattern_size;
+		for (; p <= last; ++p)
+		{
+			p = find_byte_scalar(p, last + 1, pattern[0]);
+			if (!p)
+				return nullptr;
+			if (0 == memcmp(p + 1, pattern + 1, pattern_size - 1))
+				return p;
+		}
+		return nullptr;
+	}
+
+	static size_t count_byte_scalar(const uint8_t* p, const uint8_t* end, uint8_t byte)
+	{
+		size_t count = 0;
+		for (; p < end; ++p)
+			count += (*p == byte);
+		return count;
+	}
+
+#ifdef QAPP_BYTE_SEARCH_X86
+
+	// SSE2
+
+	static const uint8_t* find_byte_sse2(const uint8_t* p, const uint8_t* end, uint8_t byte)
+	{
+		const auto needle = _mm_set1_epi8((char)byte);
+		for (; end - p >= 16; p += 16)
+		{
+			const auto mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), needle));
+			if (mask)
+				return p + std::countr_zero(mask);
+		}
+		return find_byte_scalar(p, end, byte);
+	}
+
+	static const uint8_t* find_pattern_sse2(const uint8_t* p, const uint8_t* end, const uint8_t* pattern, size_t pattern_size)
+	{
+		// Candidates match the first and last byte of the pattern, the bytes in between are compared for those
+		const auto first = _mm_set1_epi8((char)pattern[0]);
+		const auto last = _mm_set1_epi8((char)pattern[pattern_size - 1]);
+		for (; end - p >= (ptrdiff_t)(pattern_size - 1 + 16); p += 16)
+		{
+			const auto eq_first = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), first);
+			const auto eq_last = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + pattern_size - 1)), last);
+			for (auto mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(eq_first, eq_last)); mask; mask &= mask - 1)
+			{
+				const auto* candidate = p + std::countr_zero(mask);
+				if (0 == memcmp(candidate + 1, pattern + 1, pattern_size - 2))
+					return candidate;
+			}
+		}
+		return find_pattern_scalar(p, end, pattern, pattern_size);
+	}
+
+	static size_t count_byte_sse2(const uint8_t* p, const uint8_t* end, uint8_t byte)
+	{
+		// Matches are summed in byte counters, flushed before they can overflow
+		const auto needle = _mm_set1_epi8((char)byte);
+		size_t count = 0;
+		while (end - p >= 16)
+		{
+			auto counters = _mm_setzero_si128();
+			for (int i = 0; i < 255 && end - p >= 16; ++i, p += 16)
+				counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), needle));
+			const auto sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+			count += (size_t)_mm_cvtsi128_si32(sums) + (size_t)_mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+		}
+		return count + count_byte_scalar(p, end, byte);
+	}
+
+	// AVX2
+
+	QAPP_TARGET_AVX2 static const uint8_t* find_byte_avx2(const uint8_t* p, const uint8_t* end, uint8_t byte)
+	{
+		const auto needle = _mm256_set1_epi8((char)byte);
+		for (; end - p >= 32; p += 32)
+		{
+			const auto mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), needle));
+			if (mask)
+				return p + std::countr_zero(mask);
+		}
+		return find_byte_sse2(p, end, byte);
+	}
+
+	QAPP_TARGET_AVX2 static const uint8_t* find_pattern_avx2(const uint8_t* p, const uint8_t* end, const uint8_t* pattern, size_t pattern_size)
+	{
+		const auto first = _mm256_set1_epi8((char)pattern[0]);
+		const auto last = _mm256_set1_epi8((char)pattern[pattern_size - 1]);
+		for (; end - p >= (ptrdiff_t)(pattern_size - 1 + 32); p += 32)
+		{
+			const auto eq_first = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), first);
+			const auto eq_last = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + pattern_size - 1)), last);
+			for (auto mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(eq_first, eq_last)); mask; mask &= mask - 1)
+			{
+				const auto* candidate = p + std::countr_zero(mask);
+				if (0 == memcmp(candidate + 1, pattern + 1, pattern_size - 2))
+					return candidate;
+			}
+		}
+		return find_pattern_sse2(p, end, pattern, pattern_size);
+	}
+
+	QAPP_TARGET_AVX2 static size_t count_byte_avx2(const uint8_t* p, const uint8_t* end, uint8_t byte)
+	{
+		const auto needle = _mm256_set1_epi8((char)byte);
+		size_t count = 0;
+		while (end - p >= 32)
+		{
+			auto counters = _mm256_setzero_si256();
+			for (int i = 0; i < 255 && end - p >= 32; ++i, p += 32)
+				counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), needle));
+			alignas(32) uint64_t sums[4];
+			_mm256_store_si256((__m256i*)sums, _mm256_sad_epu8(counters, _mm256_setzero_si256()));
+			count += (size_t)(sums[0] + sums[1] + sums[2] + sums[3]);
+		}
+		return count + count_byte_sse2(p, end, byte);
+	}
+
+	static bool cpu_has_avx2()
+	{
+	#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		const bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+		__cpuidex(info, 7, 0);
+		return os_saves_ymm && (info[1] & (1 << 5));
+	#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+	#endif
+	}
+
+	static const bool s_HasAvx2 = cpu_has_avx2();
+
+#endif
+
+	const void* find_byte(const void* data, size_t size, uint8_t byte)
+	{
+		const auto* p = (const uint8_t*)data;
+	#ifdef QAPP_BYTE_SEARCH_X86
+		if (s_HasAvx2)
+			return find_byte_avx2(p, p + size, byte);
+		return find_byte_sse2(p, p + size, byte);
+	#else
+		return find_byte_scalar(p, p + size, byte);
+	#endif
+	}
+
+	const void* find_pattern(const void* data, size_t size, const void* pattern, size_t pattern_size)
+	{
+		const auto* p = (const uint8_t*)data;
+		if (pattern_size <= 1)
+			return pattern_size ? find_byte(data, size, *(const uint8_t*)pattern) : data;
+	#ifdef QAPP_BYTE_SEARCH_X86
+		if (s_HasAvx2)
+			return find_pattern_avx2(p, p + size, (const uint8_t*)pattern, pattern_size);
+		return find_pattern_sse2(p, p + size, (const uint8_t*)pattern, pattern_size);
+	#else
+		return find_pattern_scalar(p, p + size, (const uint8_t*)pattern, pattern_size);
+	#endif
+	}
+
+	size_t count_byte(const void* data, size_t size, uint8_t byte)
+	{
+		const auto* p = (const uint8_t*)data;
+	#ifdef QAPP_BYTE_SEARCH_X86
+		if (s_HasAvx2)
+			return count_byte_avx2(p, p + size, byte);
+		return count_byte_sse2(p, p + size, byte);
+	#else
+		return count_byte_scalar(p, p + size, byte);
+	#endif
+	}
+}
\ No newline at end of file
@@ -0,0 +1,177 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <qapplib/utils/Compression.h>
+
+namespace qapp
+{
+	// A block is a sequence of (token, literals, match) where the token holds the literal length in its high and the
+	// match length in its low four bits, each extended by bytes of 255 when 15. The match is a 16 bit little endian
+	// offset back into the output. The last sequence has literals only.
+	static const size_t MIN_MATCH = 4;
+	static const size_t LAST_LITERALS = 5;  // Bytes at the end of a block always coded as literals
+	static const size_t MAX_OFFSET = 65535;
+	static const unsigned HASH_BITS = 12;
+
+	static inline uint32_t read32(const uint8_t* p)
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static inline uint32_t hash4(uint32_t v)
+	{
+		return (v * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	static inline uint8_t* write_length(uint8_t* out, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+			*out++ = 255;
+		*out++ = (uint8_t)length;
+		return out;
+	}
+
+	static uint8_t* write_sequence(uint8_t* out, uint8_t* out_end, const uint8_t* literals, size_t literal_length, size_t offset, size_t match_length)
+	{
+		const size_t worst_size = 1 + literal_length / 255 + 1 + literal_length + 2 + match_length / 255 + 1;
+		if (worst_size > (size_t)(out_end - out))
+			return nullptr;
+		auto* token = out++;
+		*token = (uint8_t)(std::min<size_t>(literal_length, 15) << 4);
+		if (literal_length >= 15)
+			out = write_length(out, literal_length - 15);
+		memcpy(out, literals, literal_length);
+		out += literal_length;
+		if (!match_length)
+			return out;
+		*out++ = (uint8_t)offset;
+		*out++ = (uint8_t)(offset >> 8);
+		const auto length = match_length - MIN_MATCH;
+		*token |= (uint8_t)std::min<size_t>(length, 15);
+		if (length >= 15)
+			out = write_length(out, length - 15);
+		return out;
+	}
+
+	size_t lz_compress(const void* src, size_t src_size, void* dst, size_t dst_capacity)
+	{
+		const auto* in = (const uint8_t*)src;
+		const auto* in_end = in + src_size;
+		auto* out = (uint8_t*)dst;
+		auto* out_end = out + dst_capacity;
+		uint32_t table[1 << HASH_BITS] = {};  // Input offset of the last position with each hash
+
+		const auto* anchor = in;
+		if (src_size > MIN_MATCH + LAST_LITERALS)
+		{
+			const auto* match_limit = in_end - LAST_LITERALS;
+			const auto* ip = in;
+			while (ip + MIN_MATCH <= match_limit)
+			{
+				const auto v = read32(ip);
+				auto& entry = table[hash4(v)];
+				const auto* candidate = in + entry;
+				entry = (uint32_t)(ip - in);
+				if (candidate >= ip || (size_t)(ip - candidate) > MAX_OFFSET || read32(candidate) != v)
+				{
+					// Skip faster through data that does not compress
+					ip += 1 + ((ip - anchor) >> 6);
+					continue;
+				}
+				size_t match_length = MIN_MATCH;
+				while (ip + match_length < match_limit && candidate[match_length] == ip[match_length])
+					++match_length;
+				out = write_sequence(out, out_end, anchor, ip - anchor, ip - candidate, match_length);
+				if (!out)
+					return 0;
+				ip += match_length;
+				anchor = ip;
+			}
+		}
+		out = write_sequence(out, out_end, anchor, in_end - anchor, 0, 0);
+		if (!out)
+			return 0;
+		return out - (uint8_t*)dst;
+	}
+
+	static inline bool read_length(const uint8_t*& in, const uint8_t* in_end, size_t& length)
+	{
+		for (;;)
+		{
+			if (in >= in_end)
+				return false;
+			const auto b = *in++;
+			length += b;
+			if (b != 255)
+				return true;
+		}
+	}
+
+	bool lz_decompress(const void* src, size_t src_size, void* dst, size_t dst_capacity, size_t& ret_size)
+	{
+		const auto* in = (const uint8_t*)src;
+		const auto* in_end = in + src_size;
+		auto* out = (uint8_t*)dst;
+		auto* out_end = out + dst_capacity;
+		while (in < in_end)
+		{
+			const auto token = *in++;
+			size_t literal_length = token >> 4;
+			if (15 == literal_length && !read_length(in, in_end, literal_length))
+				return false;
+			if (literal_length > (size_t)(in_end - in) || literal_length > (size_t)(out_end - out))
+				return false;
+			memcpy(out, in, literal_length);
+			in += literal_length;
+			out += literal_length;
+			if (in == in_end)
+				break;
+
+			if (in_end - in < 2)
+				return false;
+			const size_t offset = in[0] | ((size_t)in[1] << 8);
+			in += 2;
+			size_t match_length = token & 15;
+			if (15 == match_length && !read_length(in, in_end, match_length))
+				return false;
+			match_length += MIN_MATCH;
+			if (!offset || offset > (size_t)(out - (uint8_t*)dst) || match_length > (size_t)(out_end - out))
+				return false;
+			const auto* match = out - offset;
+			if (offset >= match_length)
+			{
+				memcpy(out, match, match_length);
+				out += match_length;
+			}
+			else
+			{
+				// Overlapping, repeats the last offset bytes
+				for (size_t i = 0; i < match_length; ++i)
+					*out++ = match[i];
+			}
+		}
+		ret_size = out - (uint8_t*)dst;
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <qapplib/Debug.h>
+#include <qapplib/utils/Bits.h>
+#include <qapplib/utils/FilePageAllocator.h>
+
+namespace qapp
+{
+	static int create_temp_file(const std::string& directory)
+	{
+		if (directory.empty())
+			return memfd_create("qapplib_pages", MFD_CLOEXEC);
+
+		int fd = -1;
+		#ifdef O_TMPFILE
+			fd = open(directory.c_str(), O_TMPFILE | O_RDWR | O_EXCL | O_CLOEXEC, 0600);
+			if (fd >= 0)
+				return fd;
+		#endif
+
+		// File system without O_TMPFILE support, create a named file and unlink it right away
+		std::string path = directory + "/qapplib_pages_XXXXXX";
+		fd = mkostemp(path.data(), O_CLOEXEC);
+		if (fd >= 0)
+			unlink(path.c_str());
+		return fd;
+	}
+
+	CFilePageAllocator::CFilePageAllocator(size_t page_size, const std::string& directory, size_t region_size)
+		: m_PageSize(page_size)
+		, m_RegionSize(align_up(std::max(region_size, page_size), std::max(page_size, (size_t)sysconf(_SC_PAGESIZE))))
+	{
+		QAPP_ASSERT(std::has_single_bit(page_size));
+		m_Fd = create_temp_file(directory);
+		if (m_Fd < 0)
+			throw std::runtime_error(std::string("Failed to create page file: ") + strerror(errno));
+		m_CarvedSize = m_RegionSize;  // Map the first region on the first allocation
+	}
+
+	CFilePageAllocator::~CFilePageAllocator()
+	{
+		for (auto& region : m_Regions)
+			munmap(region.m_Ptr, m_RegionSize);
+		close(m_Fd);
+	}
+
+	void* CFilePageAllocator::AllocPage()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (!m_FreePages.empty())
+		{
+			auto* page = m_FreePages.back();
+			m_FreePages.pop_back();
+			return page;
+		}
+		if (m_CarvedSize >= m_RegionSize)
+			MapRegion();
+		auto* page = m_Regions.back().m_Ptr + m_CarvedSize;
+		m_CarvedSize += m_PageSize;
+		return page;
+	}
+
+	void CFilePageAllocator::FreePage(void* page)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		// The mapping is kept, but the file space is given back
+		PunchHole(FileOffset(page), m_PageSize);
+		m_FreePages.push_back(page);
+	}
+
+	void CFilePageAllocator::DecommitPage(void* page)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		PunchHole(FileOffset(page), m_PageSize);
+	}
+
+	uint64_t CFilePageAllocator::FileOffset(const void* page) const
+	{
+		// Regions are mapped at arbitrary addresses, search them all (there are few of them)
+		for (auto& region : m_Regions)
+		{
+			if (page >= region.m_Ptr && page < region.m_Ptr + m_RegionSize)
+				return region.m_FileOffset + (uint64_t)((const char*)page - region.m_Ptr);
+		}
+		QAPP_ASSERT(false && "Page not allocated from this allocator");
+		return 0;
+	}
+
+	void CFilePageAllocator::MapRegion()
+	{
+		const uint64_t file_offset = (uint64_t)m_Regions.size() * m_RegionSize;
+		if (0 != ftruncate(m_Fd, (off_t)(file_offset + m_RegionSize)))
+			throw std::bad_alloc();
+		auto* ptr = mmap(nullptr, m_RegionSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, m_Fd, (off_t)file_offset);
+		if (MAP_FAILED == ptr)
+			throw std::bad_alloc();
+		m_Regions.push_back({ (char*)ptr, file_offset });
+		m_CarvedSize = 0;
+	}
+
+	void CFilePageAllocator::PunchHole(uint64_t file_offset, size_t size)
+	{
+		fallocate(m_Fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)file_offset, (off_t)size);
+	}
+}
+
+#endif
\ No newline at end of file
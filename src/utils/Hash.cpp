@@ -0,0 +1,198 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <qapplib/utils/Hash.h>
+
+namespace qapp
+{
+	static const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+	static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+	static const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+	static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+	static const uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+	// Seed of the upper half of hash128
+	static const uint64_t HASH128_HIGH_SEED = 0x5851F42D4C957F2Dull;
+
+	// Little endian reads, as on all supported platforms
+
+	static inline uint64_t read64(const unsigned char* p)
+	{
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static inline uint32_t read32(const unsigned char* p)
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static inline uint64_t hash_round(uint64_t acc, uint64_t input)
+	{
+		acc += input * PRIME2;
+		acc = std::rotl(acc, 31);
+		return acc * PRIME1;
+	}
+
+	static inline uint64_t merge_round(uint64_t acc, uint64_t lane)
+	{
+		acc ^= hash_round(0, lane);
+		return acc * PRIME1 + PRIME4;
+	}
+
+	// Consumes whole 32 byte stripes, the four lanes are independent so that they run in parallel
+	static const unsigned char* consume_stripes(uint64_t (&lanes)[4], const unsigned char* p, const unsigned char* end)
+	{
+		auto v1 = lanes[0], v2 = lanes[1], v3 = lanes[2], v4 = lanes[3];
+		for (; end - p >= 32; p += 32)
+		{
+			v1 = hash_round(v1, read64(p));
+			v2 = hash_round(v2, read64(p + 8));
+			v3 = hash_round(v3, read64(p + 16));
+			v4 = hash_round(v4, read64(p + 24));
+		}
+		lanes[0] = v1, lanes[1] = v2, lanes[2] = v3, lanes[3] = v4;
+		return p;
+	}
+
+	static void init_lanes(uint64_t (&lanes)[4], uint64_t seed)
+	{
+		lanes[0] = seed + PRIME1 + PRIME2;
+		lanes[1] = seed + PRIME2;
+		lanes[2] = seed;
+		lanes[3] = seed - PRIME1;
+	}
+
+	static uint64_t finalize(const uint64_t (&lanes)[4], uint64_t seed, uint64_t total_size, const unsigned char* p, const unsigned char* end)
+	{
+		uint64_t h;
+		if (total_size >= 32)
+		{
+			h = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+			for (auto lane : lanes)
+				h = merge_round(h, lane);
+		}
+		else
+			h = seed + PRIME5;
+		h += total_size;
+
+		for (; end - p >= 8; p += 8)
+		{
+			h ^= hash_round(0, read64(p));
+			h = std::rotl(h, 27) * PRIME1 + PRIME4;
+		}
+		if (end - p >= 4)
+		{
+			h ^= (uint64_t)read32(p) * PRIME1;
+			h = std::rotl(h, 23) * PRIME2 + PRIME3;
+			p += 4;
+		}
+		for (; p < end; ++p)
+		{
+			h ^= *p * PRIME5;
+			h = std::rotl(h, 11) * PRIME1;
+		}
+
+		h ^= h >> 33;
+		h *= PRIME2;
+		h ^= h >> 29;
+		h *= PRIME3;
+		h ^= h >> 32;
+		return h;
+	}
+
+	uint64_t hash64(const void* data, size_t size, uint64_t seed)
+	{
+		const auto* p = (const unsigned char*)data;
+		const auto* end = p + size;
+		uint64_t lanes[4];
+		init_lanes(lanes, seed);
+		p = consume_stripes(lanes, p, end);
+		return finalize(lanes, seed, size, p, end);
+	}
+
+	hash128_t hash128(const void* data, size_t size, uint64_t seed)
+	{
+		hash128_t h;
+		h.m_Low = hash64(data, size, seed);
+		h.m_High = hash64(data, size, seed ^ HASH128_HIGH_SEED);
+		return h;
+	}
+
+	// hasher64
+
+	hasher64::hasher64(uint64_t seed)
+		: m_Seed(seed)
+	{
+		init_lanes(m_Lanes, seed);
+	}
+
+	void hasher64::update(const void* data, size_t size)
+	{
+		if (!size)
+			return;
+		const auto* p = (const unsigned char*)data;
+		const auto* end = p + size;
+		m_TotalSize += size;
+		if (m_StripeSize)
+		{
+			const auto n = std::min(sizeof(m_Stripe) - m_StripeSize, size);
+			memcpy(m_Stripe + m_StripeSize, p, n);
+			m_StripeSize += n;
+			p += n;
+			if (m_StripeSize < sizeof(m_Stripe))
+				return;
+			consume_stripes(m_Lanes, m_Stripe, m_Stripe + sizeof(m_Stripe));
+			m_StripeSize = 0;
+		}
+		p = consume_stripes(m_Lanes, p, end);
+		memcpy(m_Stripe, p, end - p);
+		m_StripeSize = end - p;
+	}
+
+	uint64_t hasher64::digest() const
+	{
+		return finalize(m_Lanes, m_Seed, m_TotalSize, m_Stripe, m_Stripe + m_StripeSize);
+	}
+
+	// hasher128
+
+	hasher128::hasher128(uint64_t seed)
+		: m_Low(seed)
+		, m_High(seed ^ HASH128_HIGH_SEED)
+	{
+	}
+
+	void hasher128::update(const void* data, size_t size)
+	{
+		m_Low.update(data, size);
+		m_High.update(data, size);
+	}
+
+	hash128_t hasher128::digest() const
+	{
+		return { m_Low.digest(), m_High.digest() };
+	}
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <qapplib/utils/MemoryPressureMonitor.h>
+
+namespace qapp
+{
+	// Upper bound on how long Stop waits should waking the thread through the event fail
+	static const int STOP_CHECK_INTERVAL_MS = 500;
+
+	CMemoryPressureMonitor::CMemoryPressureMonitor(const std::string& pressure_path, unsigned stall_us, unsigned window_us, bool full_stall)
+	{
+		m_Fd = open(pressure_path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+		if (m_Fd < 0)
+			throw std::runtime_error(std::string("Failed to open ") + pressure_path + ": " + strerror(errno));
+		char trigger[64];
+		const int n = snprintf(trigger, sizeof(trigger), "%s %u %u", full_stall ? "full" : "some", stall_us, window_us);
+		if (write(m_Fd, trigger, n + 1) < 0)
+		{
+			const int error = errno;
+			close(m_Fd);
+			throw std::runtime_error(std::string("Failed to arm memory pressure trigger: ") + strerror(error));
+		}
+		m_StopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (m_StopFd < 0)
+		{
+			const int error = errno;
+			close(m_Fd);
+			throw std::runtime_error(std::string("Failed to create memory pressure monitor event: ") + strerror(error));
+		}
+	}
+
+	CMemoryPressureMonitor::~CMemoryPressureMonitor()
+	{
+		StopThread();
+		close(m_StopFd);
+		close(m_Fd);
+	}
+
+	bool CMemoryPressureMonitor::Wait(int timeout_ms)
+	{
+		pollfd fds[2] = { { m_Fd, POLLPRI, 0 }, { m_StopFd, POLLIN, 0 } };
+		for (;;)
+		{
+			const int n = poll(fds, 2, timeout_ms);
+			if (n < 0 && EINTR == errno)
+				continue;
+			if (n < 0 || (fds[0].revents & POLLERR))
+				throw std::runtime_error("Memory pressure monitor failed");
+			return n > 0 && (fds[0].revents & POLLPRI);
+		}
+	}
+
+	void CMemoryPressureMonitor::Start(std::function<void()> on_pressure)
+	{
+		Stop();
+		m_Stopping = false;
+		m_Thread = std::thread([this, on_pressure = std::move(on_pressure)]
+		{
+			try
+			{
+				while (!m_Stopping.load(std::memory_order_relaxed))
+				{
+					if (Wait(STOP_CHECK_INTERVAL_MS))
+						on_pressure();
+				}
+			}
+			catch (...)
+			{
+				m_ThreadError = std::current_exception();
+			}
+		});
+	}
+
+	void CMemoryPressureMonitor::Stop()
+	{
+		StopThread();
+		if (m_ThreadError)
+			std::rethrow_exception(std::exchange(m_ThreadError, nullptr));
+	}
+
+	void CMemoryPressureMonitor::StopThread()
+	{
+		if (!m_Thread.joinable())
+			return;
+		m_Stopping = true;
+		// Wakes the thread right away, should the write fail it still sees m_Stopping within STOP_CHECK_INTERVAL_MS
+		const uint64_t one = 1;
+		const bool woken = write(m_StopFd, &one, sizeof(one)) == sizeof(one);
+		m_Thread.join();
+		uint64_t count;
+		if (woken && read(m_StopFd, &count, sizeof(count)) != sizeof(count) && !m_ThreadError)
+			m_ThreadError = std::make_exception_ptr(std::runtime_error(std::string("Failed to reset memory pressure monitor event: ") + strerror(errno)));
+	}
+}
+
+#endif
\ No newline at end of file
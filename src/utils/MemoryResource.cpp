@@ -0,0 +1,104 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <bit>
+
+#include <qapplib/Debug.h>
+
+#include <qapplib/utils/MemoryResource.h>
+
+namespace qapp
+{
+	void* page_stack_resource::do_allocate(size_t bytes, size_t alignment)
+	{
+		return m_Allocator.alloc(bytes, alignment);
+	}
+
+	void page_stack_resource::do_deallocate(void* /*p*/, size_t /*bytes*/, size_t /*alignment*/)
+	{
+	}
+
+	bool page_stack_resource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+	{
+		return this == &other;
+	}
+
+	page_pool_resource::page_pool_resource(CPagePool& page_pool, std::pmr::memory_resource* upstream)
+		: m_PagePool(page_pool)
+		, m_Upstream(upstream)
+		, m_MaxSlotSize(std::min(std::max(page_pool.PageSizeMax() / 8, (size_t)1 << MIN_SLOT_SIZE_BITS), (size_t)1 << (MIN_SLOT_SIZE_BITS + MAX_SIZE_CLASSES - 1)))
+	{
+		QAPP_ASSERT(m_Upstream);
+	}
+
+	page_pool_resource::~page_pool_resource()
+	{
+		release();
+	}
+
+	void page_pool_resource::release()
+	{
+		for (auto& slab : m_Slabs)
+			slab.reset();
+	}
+
+	void* page_pool_resource::do_allocate(size_t bytes, size_t alignment)
+	{
+		const auto size = block_size(bytes, alignment);
+		if (!size)
+			return m_Upstream->allocate(bytes, alignment);
+		if (size <= m_MaxSlotSize)
+			return slab(size).alloc();
+		return m_PagePool.PtrFromHandle(m_PagePool.Alloc((unsigned char)std::countr_zero(size)));
+	}
+
+	void page_pool_resource::do_deallocate(void* p, size_t bytes, size_t alignment)
+	{
+		const auto size = block_size(bytes, alignment);
+		if (!size)
+			m_Upstream->deallocate(p, bytes, alignment);
+		else if (size <= m_MaxSlotSize)
+			slab(size).free(p);
+		else
+			m_PagePool.Free(m_PagePool.HandleFromPtr(p, (unsigned char)std::countr_zero(size)));
+	}
+
+	bool page_pool_resource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+	{
+		return this == &other;
+	}
+
+	size_t page_pool_resource::block_size(size_t bytes, size_t alignment) const
+	{
+		if (alignment > m_PagePool.PageSizeMin() || bytes > m_PagePool.PageSizeMax())
+			return 0;
+		const auto size = std::bit_ceil(std::max({ bytes, alignment, (size_t)1 << MIN_SLOT_SIZE_BITS }));
+		return size <= m_MaxSlotSize ? size : std::max(size, m_PagePool.PageSizeMin());
+	}
+
+	page_slab_base& page_pool_resource::slab(size_t size)
+	{
+		auto& slab = m_Slabs[std::countr_zero(size) - MIN_SLOT_SIZE_BITS];
+		// Power of two slots in power of two pages are aligned to their size
+		if (!slab)
+			slab = std::make_unique<page_slab_base>(m_PagePool, size, std::min(size, m_PagePool.PageSizeMin()));
+		return *slab;
+	}
+}
\ No newline at end of file
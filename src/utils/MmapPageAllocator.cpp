@@ -0,0 +1,188 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <cstdio>
+#include <new>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <qapplib/Debug.h>
+#include <qapplib/utils/Bits.h>
+#include <qapplib/utils/MmapPageAllocator.h>
+
+namespace qapp
+{
+	// Default size of the explicit huge pages, 0 when unknown
+	static size_t huge_page_size()
+	{
+		size_t size = 0;
+		if (auto* file = fopen("/proc/meminfo", "r"))
+		{
+			char line[128];
+			unsigned long kib = 0;
+			while (fgets(line, sizeof(line), file))
+			{
+				if (1 == sscanf(line, "Hugepagesize: %lu kB", &kib))
+				{
+					size = (size_t)kib << 10;
+					break;
+				}
+			}
+			fclose(file);
+		}
+		return std::has_single_bit(size) ? size : 0;
+	}
+
+	CMmapPageAllocator::CMmapPageAllocator(size_t page_size, size_t region_size, EHugePages huge_pages)
+		: m_PageSize(page_size)
+		, m_RegionSize(align_up(std::max(region_size, page_size), page_size))
+		, m_HugePages(huge_pages)
+	{
+		QAPP_ASSERT(std::has_single_bit(page_size));
+	}
+
+	CMmapPageAllocator::~CMmapPageAllocator()
+	{
+		for (auto& region : m_Regions)
+			munmap(region.m_Ptr, region.m_Size);
+	}
+
+	void* CMmapPageAllocator::AllocPage()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		SRegion* region = nullptr;
+		for (auto& r : m_Regions)
+		{
+			if (!r.m_FreePages.empty() || r.m_CarvedSize < r.m_Size)
+			{
+				region = &r;
+				break;
+			}
+		}
+		if (!region)
+			region = MapRegion();
+
+		++region->m_UsedPages;
+		if (!region->m_FreePages.empty())
+		{
+			auto* page = region->m_FreePages.back();
+			region->m_FreePages.pop_back();
+			return page;
+		}
+		auto* page = region->m_Ptr + region->m_CarvedSize;
+		region->m_CarvedSize += m_PageSize;
+		return page;
+	}
+
+	void CMmapPageAllocator::FreePage(void* page)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto it = std::upper_bound(m_Regions.begin(), m_Regions.end(), (char*)page, [](const char* p, const SRegion& r) { return p < r.m_Ptr; });
+		QAPP_ASSERT(it != m_Regions.begin());
+		auto& region = *(it - 1);
+		QAPP_ASSERT((char*)page < region.m_Ptr + region.m_Size);
+		if (--region.m_UsedPages)
+		{
+			region.m_FreePages.push_back(page);
+			return;
+		}
+		UnmapRegion(region);
+	}
+
+	void CMmapPageAllocator::DecommitPage(void* page)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			auto it = std::upper_bound(m_Regions.begin(), m_Regions.end(), (char*)page, [](const char* p, const SRegion& r) { return p < r.m_Ptr; });
+			QAPP_ASSERT(it != m_Regions.begin());
+			// Huge pages are released whole, decommitting a smaller page would drop its neighbours along with it
+			if ((it - 1)->m_HugePageSize > m_PageSize)
+				return;
+		}
+		decommit_pages(page, m_PageSize);
+	}
+
+	CMmapPageAllocator::SRegion* CMmapPageAllocator::MapRegion()
+	{
+		SRegion region;
+		region.m_Size = m_RegionSize;
+
+		#ifdef MAP_HUGETLB
+			static const size_t explicit_huge_page_size = huge_page_size();
+			if (EHugePages::Explicit == m_HugePages && explicit_huge_page_size)
+			{
+				// The length must be a multiple of the huge page size or munmap fails and the region leaks. The mapping
+				// is only aligned to the huge page size, pages larger than that need over-reserving and trimming,
+				// which stays on huge page boundaries since both sizes are powers of two
+				const auto size = align_up(m_RegionSize, explicit_huge_page_size);
+				const auto padding = m_PageSize > explicit_huge_page_size ? m_PageSize : 0;
+				// No MAP_NORESERVE here: the huge pages must be reserved up front, otherwise touching the region
+				// raises SIGBUS once the huge page pool is exhausted
+				auto* ptr = (char*)mmap(nullptr, size + padding, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+				if (MAP_FAILED != (void*)ptr)
+				{
+					auto* aligned_ptr = (char*)align_up((uintptr_t)ptr, m_PageSize);
+					if (aligned_ptr > ptr)
+						munmap(ptr, aligned_ptr - ptr);
+					if (ptr + padding > aligned_ptr)
+						munmap(aligned_ptr + size, ptr + padding - aligned_ptr);
+					region.m_Ptr = aligned_ptr;
+					region.m_Size = size;
+					region.m_HugePageSize = explicit_huge_page_size;
+				}
+			}
+		#endif
+
+		if (!region.m_Ptr)
+		{
+			// Over-reserve and trim both ends so that the pages end up aligned to the page size
+			const auto system_page_size = (size_t)sysconf(_SC_PAGESIZE);
+			const auto padding = m_PageSize > system_page_size ? m_PageSize : 0;
+			auto* ptr = (char*)mmap(nullptr, m_RegionSize + padding, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+			if (MAP_FAILED == (void*)ptr)
+				throw std::bad_alloc();
+			auto* aligned_ptr = (char*)align_up((uintptr_t)ptr, m_PageSize);
+			if (aligned_ptr > ptr)
+				munmap(ptr, aligned_ptr - ptr);
+			if (ptr + padding > aligned_ptr)
+				munmap(aligned_ptr + m_RegionSize, ptr + padding - aligned_ptr);
+			region.m_Ptr = aligned_ptr;
+
+			#ifdef MADV_HUGEPAGE
+				if (EHugePages::None != m_HugePages)
+					madvise(region.m_Ptr, region.m_Size, MADV_HUGEPAGE);
+			#endif
+		}
+
+		const auto it = std::upper_bound(m_Regions.begin(), m_Regions.end(), region.m_Ptr, [](const char* p, const SRegion& r) { return p < r.m_Ptr; });
+		return &*m_Regions.insert(it, std::move(region));
+	}
+
+	void CMmapPageAllocator::UnmapRegion(SRegion& region)
+	{
+		munmap(region.m_Ptr, region.m_Size);
+		m_Regions.erase(m_Regions.begin() + (&region - m_Regions.data()));
+	}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,95 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef _WIN32
+	#include <Windows.h>
+#else
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+#include <new>
+
+#include <qapplib/utils/Bits.h>
+#include <qapplib/utils/PageAllocator.h>
+
+namespace qapp
+{
+	static size_t system_page_size()
+	{
+		#ifdef _WIN32
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			return info.dwPageSize;
+		#else
+			return (size_t)sysconf(_SC_PAGESIZE);
+		#endif
+	}
+
+	void decommit_pages(void* ptr, size_t size)
+	{
+		static const size_t page_size = system_page_size();
+		const auto beg = align_up((uintptr_t)ptr, page_size);
+		const auto end = ((uintptr_t)ptr + size) & ~(uintptr_t)(page_size - 1);
+		if (end <= beg)
+			return;
+		#ifdef _WIN32
+			VirtualAlloc((void*)beg, end - beg, MEM_RESET, PAGE_READWRITE);
+		#elif defined(MADV_FREE)
+			madvise((void*)beg, end - beg, MADV_FREE);
+		#else
+			madvise((void*)beg, end - beg, MADV_DONTNEED);
+		#endif
+	}
+
+	void prefault_pages(void* ptr, size_t size)
+	{
+		static const size_t page_size = system_page_size();
+		#ifdef MADV_POPULATE_WRITE
+			const auto beg = (uintptr_t)ptr & ~(uintptr_t)(page_size - 1);
+			if (0 == madvise((void*)beg, (uintptr_t)ptr + size - beg, MADV_POPULATE_WRITE))
+				return;
+		#endif
+		for (size_t offset = 0; offset < size; offset += page_size)
+			((volatile char*)ptr)[offset] = 0;
+	}
+
+	void* map_pages(size_t size)
+	{
+		#ifdef _WIN32
+			auto* ptr = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+			if (!ptr)
+				throw std::bad_alloc();
+		#else
+			auto* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+			if (MAP_FAILED == ptr)
+				throw std::bad_alloc();
+		#endif
+		return ptr;
+	}
+
+	void unmap_pages(void* ptr, size_t size)
+	{
+		#ifdef _WIN32
+			VirtualFree(ptr, 0, MEM_RELEASE);
+		#else
+			munmap(ptr, size);
+		#endif
+	}
+}
\ No newline at end of file
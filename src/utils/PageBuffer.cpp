@@ -18,29 +18,127 @@ along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+#include <qapplib/utils/ByteSearch.h>
+#include <qapplib/utils/Compression.h>
 #include <qapplib/utils/PageBuffer.h>
 
 namespace qapp
 {
-	page_buffer::page_buffer(CPagePool& page_pool)
+	// Truncating a buffer keeps up to this many trailing pages (or an eighth of the pages in use, if more) for the
+	// buffer to grow into again, so that repeated append/truncate cycles do not keep allocating and freeing pages
+	static const size_t TRUNCATE_SLACK_PAGES = 2;
+
+	// Number of pages looked at for compression per operation on a buffer with compression enabled
+	static const size_t COMPRESSION_SCAN_PAGES = 4;
+
+	struct page_buffer::compression_state
+	{
+		size_t m_IdleOperations = 0;
+		size_t m_Operation = 0;
+		size_t m_ScanPos = 0;
+		std::vector<size_t> m_LastAccess;  // Operation during which each page was last accessed
+		std::vector<uint32_t> m_CompressedSizes;  // 0 for pages not compressed
+		std::vector<char> m_Scratch;
+	};
+
+	struct page_buffer::hash_cache
+	{
+		std::vector<uint64_t> m_BlockHashes;
+		std::vector<bool> m_ValidBlocks;
+	};
+
+#ifndef _WIN32
+	// Max number of segments passed to each vectored I/O call, the usual IOV_MAX
+	static const int IO_BATCH_SEGMENTS = 1024;
+
+	// Transfers all of iov, unless the end of the file is reached when reading. Returns the number of bytes
+	// transferred.
+	static size_t transfer_segments(int fd, iovec* iov, int iov_count, int64_t file_offset, bool write)
+	{
+		size_t total = 0;
+		while (iov_count)
+		{
+			ssize_t n;
+			if (file_offset < 0)
+				n = write ? ::writev(fd, iov, iov_count) : ::readv(fd, iov, iov_count);
+			else if (write)
+				n = ::pwritev(fd, iov, iov_count, file_offset + (int64_t)total);
+			else
+				n = ::preadv(fd, iov, iov_count, file_offset + (int64_t)total);
+			if (n < 0)
+			{
+				if (EINTR == errno)
+					continue;
+				throw std::runtime_error(std::string(write ? "Failed to write page buffer: " : "Failed to read page buffer: ") + strerror(errno));
+			}
+			if (0 == n)
+			{
+				if (write)
+					throw std::runtime_error("Failed to write page buffer: no progress");
+				break;
+			}
+			total += n;
+
+			// Skip the segments transferred completely and trim the one transferred partially
+			while (iov_count && (size_t)n >= iov->iov_len)
+			{
+				n -= iov->iov_len;
+				++iov;
+				--iov_count;
+			}
+			if (iov_count)
+			{
+				iov->iov_base = (char*)iov->iov_base + n;
+				iov->iov_len -= n;
+			}
+		}
+		return total;
+	}
+#endif
+
+	page_buffer::page_buffer(CPagePool& page_pool, EGrowth growth)
 		: m_PagePool(page_pool)
 	{
+		m_Layout.m_PageSizeBits = m_PagePool.PageSizeMinBits();
+		m_Layout.m_PageSizeMaxBits = m_PagePool.PageSizeMaxBits();
+		m_Layout.m_Chained = EGrowth::Chain == growth;
 	}
 
 	page_buffer::~page_buffer()
 	{
-		for (auto handle : m_Pages)
-			m_PagePool.Free(handle);
+		for (size_t i = 0; i < m_Pages.size(); ++i)
+			release_page(i);
 		m_Pages.clear();
+		m_SharedPages.clear();
 	}
 
 	void page_buffer::clear()
 	{
+		if (m_HashCache)
+			invalidate_hashes(0, m_Size);
 		m_Size = 0;
+		trim_capacity();
 	}
 
 	void page_buffer::resize(size_t size)
 	{
+		if (m_HashCache)
+			invalidate_hashes(std::min(size, m_Size), std::max(size, m_Size));
+		if (size < m_Size)
+		{
+			m_Size = size;
+			trim_capacity();
+			return;
+		}
 		reserve(size);
 		m_Size = size;
 	}
@@ -49,24 +147,61 @@ namespace qapp
 	{
 		if (size <= capacity())
 			return;
+		if (m_Layout.m_Chained)
+		{
+			while (capacity() < size)
+				add_page(m_Layout.page_size(m_Pages.size()));
+			return;
+		}
 		const auto page_size_bytes = std::max(page_size_min(), std::min(std::bit_ceil(size), page_size_max()));
 		const auto page_size_bits = (unsigned char)std::countr_zero(page_size_bytes);
 		if (capacity() < page_size_max())
 		{
 			const auto new_handle = m_PagePool.Alloc(page_size_bits);
-			if (empty())
+			if (m_Pages.empty())
+			{
 				m_Pages.push_back(new_handle);
+				m_SharedPages.push_back(false);
+				if (m_Compression)
+				{
+					m_Compression->m_LastAccess.push_back(m_Compression->m_Operation);
+					m_Compression->m_CompressedSizes.push_back(0);
+				}
+			}
 			else
 			{
-				memcpy(m_PagePool.PtrFromHandle(new_handle), m_PagePool.PtrFromHandle(m_Pages.front()), this->size());
-				m_PagePool.Free(m_Pages.front());
+				memcpy(m_PagePool.PtrFromHandle(new_handle), page_ptr(0), this->size());
+				release_page(0);
 				m_Pages.front() = new_handle;
+				m_SharedPages.front() = false;
 			}
 		}
-		if (page_size_bytes == page_size_max())
-			while (m_Pages.size() < (size + page_size_bytes - 1) >> page_size_bits)
-				m_Pages.push_back(m_PagePool.Alloc(page_size_max_bits()));
-		m_Capacity = page_size_bytes * m_Pages.size();
+		m_Layout.m_PageSizeBits = page_size_bits;
+		m_Capacity = m_Layout.capacity(m_Pages.size());
+		while (capacity() < size)
+			add_page(page_size_bytes);
+	}
+
+	void page_buffer::shrink_to_fit()
+	{
+		if (m_Pages.size() > 1 || m_Layout.m_Chained || empty())
+		{
+			truncate_pages(m_Layout.page_count(size()));
+			return;
+		}
+
+		// Single page, move the contents to the smallest page holding them
+		const auto page_size_bytes = std::max(page_size_min(), std::bit_ceil(size()));
+		if (page_size_bytes >= capacity())
+			return;
+		const auto page_size_bits = (unsigned char)std::countr_zero(page_size_bytes);
+		const auto new_handle = m_PagePool.Alloc(page_size_bits);
+		memcpy(m_PagePool.PtrFromHandle(new_handle), page_ptr(0), size());
+		release_page(0);
+		m_Pages.front() = new_handle;
+		m_SharedPages.front() = false;
+		m_Layout.m_PageSizeBits = page_size_bits;
+		m_Capacity = page_size_bytes;
 	}
 
 	void page_buffer::append(const void* data, size_t size)
@@ -76,23 +211,12 @@ namespace qapp
 
 	void page_buffer::write(size_t offset, const void* data, size_t size)
 	{
-		reserve(offset + size);
 		const char* p = (const char*)data;
-		const char* end = p + size;
-		const auto page_size = this->page_size();
-		size_t page_index, page_offset;
-		locate(offset, page_index, page_offset);
-		for (;;)
+		for_each_writable_segment(offset, size, [&](void* segment, size_t n)
 		{
-			const auto n = std::min(page_size - page_offset, (size_t)(end - p));
-			memcpy((char*)page_ptr(page_index) + page_offset, p, n);
+			memcpy(segment, p, n);
 			p += n;
-			if (p >= end)
-				break;
-			++page_index;
-			page_offset = 0;
-		}
-		m_Size = std::max(m_Size, offset + size);
+		});
 	}
 
 	size_t page_buffer::read(size_t offset, void* buffer, size_t buffer_size) const
@@ -100,38 +224,335 @@ namespace qapp
 		if (offset > size())
 			return 0;  // TODO: raise exception?
 		char* p = (char*)buffer;
-		const auto size_to_read = std::min(size() - offset, buffer_size);
-		const char* end = p + size_to_read;
-		const auto page_size = this->page_size();
-		size_t page_index, page_offset;
-		locate(offset, page_index, page_offset);
-		for (;;)
+		for_each_segment(offset, buffer_size, [&](const void* segment, size_t n)
 		{
-			const auto n = std::min(page_size - page_offset, (size_t)(end - p));
-			memcpy(p, (const char*)page_ptr(page_index) + page_offset, n);
+			memcpy(p, segment, n);
 			p += n;
-			if (p >= end)
+		});
+		return p - (char*)buffer;
+	}
+
+	size_t page_buffer::find(uint8_t byte, size_t offset) const
+	{
+		return find_byte_in(*this, offset, byte);
+	}
+
+	size_t page_buffer::find(const void* pattern, size_t pattern_size, size_t offset) const
+	{
+		return find_pattern_in(*this, offset, pattern, pattern_size);
+	}
+
+	size_t page_buffer::count(uint8_t byte, size_t offset, size_t size) const
+	{
+		return count_byte_in(*this, offset, size, byte);
+	}
+
+	uint64_t page_buffer::hash(size_t offset, size_t size) const
+	{
+		hasher64 hasher;
+		for_each_segment(offset, size, [&](const void* data, size_t n)
+		{
+			hasher.update(data, n);
+		});
+		return hasher.digest();
+	}
+
+	hash128_t page_buffer::hash128(size_t offset, size_t size) const
+	{
+		hasher128 hasher;
+		for_each_segment(offset, size, [&](const void* data, size_t n)
+		{
+			hasher.update(data, n);
+		});
+		return hasher.digest();
+	}
+
+	uint64_t page_buffer::content_hash() const
+	{
+		detach_writers();
+		if (!m_HashCache)
+			m_HashCache = std::make_unique<hash_cache>();
+		auto& cache = *m_HashCache;
+		const auto block_size = page_size_min();
+		const auto block_count = (size() + block_size - 1) / block_size;
+		cache.m_BlockHashes.resize(block_count);
+		cache.m_ValidBlocks.resize(block_count);
+		for (size_t i = 0; i < block_count; ++i)
+		{
+			if (!cache.m_ValidBlocks[i])
+			{
+				cache.m_BlockHashes[i] = hash(i * block_size, block_size);
+				cache.m_ValidBlocks[i] = true;
+			}
+		}
+		hasher64 hasher;
+		hasher.update(cache.m_BlockHashes.data(), block_count * sizeof(uint64_t));
+		hasher.update(&m_Size, sizeof(m_Size));
+		return hasher.digest();
+	}
+
+	void page_buffer::invalidate_hashes(size_t beg, size_t end)
+	{
+		auto& valid_blocks = m_HashCache->m_ValidBlocks;
+		const auto block_size_bits = m_PagePool.PageSizeMinBits();
+		const auto last_block = std::min(valid_blocks.size(), (end + page_size_min() - 1) >> block_size_bits);
+		for (auto i = beg >> block_size_bits; i < last_block; ++i)
+			valid_blocks[i] = false;
+	}
+
+	page_buffer_snapshot page_buffer::snapshot()
+	{
+		detach_writers();
+		// Snapshots read their pages directly, they can not be compressed
+		if (m_Compression)
+		{
+			for (size_t i = 0; i < m_Pages.size(); ++i)
+				access_page(i);
+		}
+		while (m_Snapshot && 1 == m_Snapshot.use_count())
+			reclaim_snapshot();
+
+		// The new snapshot takes over the pages that are not already owned by a previous one
+		auto state = std::make_shared<page_buffer_snapshot::state>();
+		state->m_PagePool = &m_PagePool;
+		state->m_Size = size();
+		state->m_Layout = m_Layout;
+		state->m_Pages = m_Pages;
+		state->m_OwnedPages.resize(m_Pages.size());
+		for (size_t i = 0; i < m_Pages.size(); ++i)
+			state->m_OwnedPages[i] = !m_SharedPages[i];
+		state->m_Parent = std::move(m_Snapshot);
+		m_Snapshot = state;
+		m_SharedPages.assign(m_Pages.size(), true);
+
+		page_buffer_snapshot snapshot;
+		snapshot.m_State = std::move(state);
+		return snapshot;
+	}
+
+	void* page_buffer::writable_page_at(size_t offset, size_t& ret_size)
+	{
+		if (m_Compression)
+			on_operation();
+		return writable_page_ptr(offset, ret_size);
+	}
+
+	void page_buffer::set_compression(size_t idle_operations)
+	{
+		if (!idle_operations)
+		{
+			if (!m_Compression)
+				return;
+			for (size_t i = 0; i < m_Pages.size(); ++i)
+				access_page(i);
+			m_Compression.reset();
+			return;
+		}
+		if (!m_Compression)
+		{
+			m_Compression = std::make_unique<compression_state>();
+			m_Compression->m_LastAccess.resize(m_Pages.size());
+			m_Compression->m_CompressedSizes.resize(m_Pages.size());
+		}
+		m_Compression->m_IdleOperations = idle_operations;
+	}
+
+	size_t page_buffer::compress_cold_pages()
+	{
+		if (!m_Compression)
+			return 0;
+		size_t count = 0;
+		for (size_t i = 0; i < m_Pages.size(); ++i)
+		{
+			if (is_cold(i) && compress_page(i))
+				++count;
+		}
+		return count;
+	}
+
+	void page_buffer::add_writer(in_place_writer* writer)
+	{
+		m_Writers.push_back(writer);
+	}
+
+	void page_buffer::remove_writer(in_place_writer* writer)
+	{
+		std::erase(m_Writers, writer);
+	}
+
+	void page_buffer::detach_writers() const
+	{
+		// Writers keep writing to their page without make_page_writable or invalidate_hashes, both of which a
+		// snapshot or a cached hash relies on
+		const auto writers = m_Writers;  // Detaching removes them
+		for (auto* writer : writers)
+			writer->detach();
+	}
+
+	void page_buffer::pin_page(size_t offset) const
+	{
+		size_t page_index, page_offset;
+		m_Layout.locate(offset, page_index, page_offset);
+		m_PinnedPages.push_back(page_index);
+	}
+
+	void page_buffer::unpin_page(size_t offset) const
+	{
+		size_t page_index, page_offset;
+		m_Layout.locate(offset, page_index, page_offset);
+		const auto it = std::find(m_PinnedPages.begin(), m_PinnedPages.end(), page_index);
+		if (it != m_PinnedPages.end())
+		{
+			*it = m_PinnedPages.back();
+			m_PinnedPages.pop_back();
+		}
+	}
+
+	void* page_buffer::writable_page_ptr(size_t offset, size_t& ret_size)
+	{
+		reserve(offset + 1);
+		size_t page_index, page_offset;
+		m_Layout.locate(offset, page_index, page_offset);
+		if (m_Snapshot)
+			make_page_writable(page_index);
+		ret_size = m_Layout.page_size(page_index) - page_offset;
+		if (m_HashCache)
+			invalidate_hashes(std::min(offset, m_Size), offset + ret_size);
+		return (char*)page_ptr(page_index) + page_offset;
+	}
+
+#ifndef _WIN32
+	size_t page_buffer::write_to(int fd, size_t offset, size_t size, int64_t file_offset) const
+	{
+		iovec iov[IO_BATCH_SEGMENTS];
+		int iov_count = 0;
+		size_t total = 0;
+		const auto flush = [&]()
+		{
+			total += transfer_segments(fd, iov, iov_count, file_offset < 0 ? file_offset : file_offset + (int64_t)total, true);
+			iov_count = 0;
+		};
+		for_each_segment(offset, size, [&](const void* data, size_t n)
+			{
+				iov[iov_count++] = { (void*)data, n };
+				if (IO_BATCH_SEGMENTS == iov_count)
+					flush();
+			});
+		if (iov_count)
+			flush();
+		return total;
+	}
+
+	size_t page_buffer::read_from(int fd, size_t offset, size_t size, int64_t file_offset)
+	{
+		reserve(offset + size);
+		if (m_Compression)
+			on_operation();
+		iovec iov[IO_BATCH_SEGMENTS];
+		size_t total = 0;
+		while (total < size)
+		{
+			int iov_count = 0;
+			size_t batch_size = 0;
+			while (iov_count < IO_BATCH_SEGMENTS && total + batch_size < size)
+			{
+				size_t n;
+				auto* data = writable_page_ptr(offset + total + batch_size, n);
+				n = std::min(n, size - total - batch_size);
+				iov[iov_count++] = { data, n };
+				batch_size += n;
+			}
+			const auto n = transfer_segments(fd, iov, iov_count, file_offset < 0 ? file_offset : file_offset + (int64_t)total, false);
+			total += n;
+			if (n < batch_size)
 				break;
-			++page_index;
-			page_offset = 0;
 		}
-		return size_to_read;
+		m_Size = std::max(m_Size, offset + total);
+		trim_capacity();
+		return total;
+	}
+#endif
+
+	void page_buffer::make_page_writable(size_t page_index)
+	{
+		if (!m_SharedPages[page_index])
+			return;
+		while (m_Snapshot && 1 == m_Snapshot.use_count())
+			reclaim_snapshot();
+		if (!m_SharedPages[page_index])
+			return;
+		const auto shared_handle = m_Pages[page_index];
+		const auto page_size = m_PagePool.PageSize(shared_handle);
+		const auto new_handle = m_PagePool.Alloc((unsigned char)std::countr_zero(page_size));
+		memcpy(m_PagePool.PtrFromHandle(new_handle), m_PagePool.PtrFromHandle(shared_handle), page_size);
+		m_Pages[page_index] = new_handle;
+		m_SharedPages[page_index] = false;
+	}
+
+	void page_buffer::reclaim_snapshot()
+	{
+		// No snapshot refers to the latest state any more, take back the shared pages it owns. The shared pages it
+		// does not own belong to its parent, which becomes the latest state.
+		auto& state = *m_Snapshot;
+		const auto n = std::min(state.m_Pages.size(), m_Pages.size());
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (m_SharedPages[i] && state.m_OwnedPages[i] && state.m_Pages[i] == m_Pages[i])
+			{
+				state.m_OwnedPages[i] = false;
+				m_SharedPages[i] = false;
+			}
+		}
+		auto parent = std::move(state.m_Parent);
+		m_Snapshot = std::move(parent);
+	}
+
+	void page_buffer::release_page(size_t page_index)
+	{
+		if (!m_SharedPages[page_index])
+			m_PagePool.Free(m_Pages[page_index]);
 	}
 
-	void page_buffer::locate(size_t offset, size_t& ret_page_index, size_t& ret_page_offset) const
+	void page_buffer::truncate_pages(size_t page_count)
 	{
-		ret_page_index = offset >> page_size_max_bits();
-		ret_page_offset = offset & (page_size_max() - 1);
+		// Snapshots nobody refers to any more would keep the pages alive
+		while (m_Snapshot && 1 == m_Snapshot.use_count())
+			reclaim_snapshot();
+
+		while (m_Pages.size() > page_count)
+		{
+			release_page(m_Pages.size() - 1);
+			m_Pages.pop_back();
+			m_SharedPages.pop_back();
+		}
+		if (m_Compression)
+		{
+			m_Compression->m_LastAccess.resize(m_Pages.size());
+			m_Compression->m_CompressedSizes.resize(m_Pages.size());
+		}
+		m_Capacity = m_Layout.capacity(m_Pages.size());
 	}
 
-	size_t page_buffer::page_size() const
+	void page_buffer::trim_capacity()
 	{
-		return std::min(capacity(), page_size_max());
+		if (m_Pages.size() <= 1)
+			return;
+		const auto used_page_count = m_Layout.page_count(size());
+		const auto slack_page_count = std::max(TRUNCATE_SLACK_PAGES, used_page_count / 8);
+		if (m_Pages.size() > used_page_count + slack_page_count)
+			truncate_pages(used_page_count + slack_page_count);
 	}
 
-	unsigned char page_buffer::page_size_max_bits() const
+	void page_buffer::add_page(size_t page_size)
 	{
-		return m_PagePool.PageSizeMaxBits();
+		m_Pages.push_back(m_PagePool.Alloc((unsigned char)std::countr_zero(page_size)));
+		m_SharedPages.push_back(false);
+		if (m_Compression)
+		{
+			m_Compression->m_LastAccess.push_back(m_Compression->m_Operation);
+			m_Compression->m_CompressedSizes.push_back(0);
+		}
+		m_Capacity = m_Layout.capacity(m_Pages.size());
 	}
 
 	size_t page_buffer::page_size_min() const
@@ -146,14 +567,110 @@ namespace qapp
 
 	void* page_buffer::page_ptr(size_t page_index)
 	{
+		if (m_Compression)
+			return (void*)access_page(page_index);
 		return m_PagePool.PtrFromHandle(m_Pages[page_index]);
 	}
 
 	const void* page_buffer::page_ptr(size_t page_index) const
 	{
+		if (m_Compression)
+			return access_page(page_index);
+		return m_PagePool.PtrFromHandle(m_Pages[page_index]);
+	}
+
+	void page_buffer::on_operation() const
+	{
+		// Look at a few pages per operation and compress the first cold one found
+		auto& state = *m_Compression;
+		++state.m_Operation;
+		for (size_t n = std::min(COMPRESSION_SCAN_PAGES, m_Pages.size()); n; --n)
+		{
+			if (state.m_ScanPos >= m_Pages.size())
+				state.m_ScanPos = 0;
+			const auto page_index = state.m_ScanPos++;
+			if (is_cold(page_index) && compress_page(page_index))
+				return;
+		}
+	}
+
+	const void* page_buffer::access_page(size_t page_index) const
+	{
+		auto& state = *m_Compression;
+		state.m_LastAccess[page_index] = state.m_Operation;
+		if (state.m_CompressedSizes[page_index])
+			decompress_page(page_index);
 		return m_PagePool.PtrFromHandle(m_Pages[page_index]);
 	}
 
+	bool page_buffer::is_cold(size_t page_index) const
+	{
+		const auto& state = *m_Compression;
+		return !state.m_CompressedSizes[page_index] && !m_SharedPages[page_index] &&
+			state.m_Operation - state.m_LastAccess[page_index] >= state.m_IdleOperations &&
+			std::find(m_PinnedPages.begin(), m_PinnedPages.end(), page_index) == m_PinnedPages.end();
+	}
+
+	bool page_buffer::compress_page(size_t page_index) const
+	{
+		// Only worth it if the compressed page fits in a pool page at most half the size
+		auto& state = *m_Compression;
+		const auto page_size = m_Layout.page_size(page_index);
+		const auto page_begin = m_Layout.capacity(page_index);
+		if (page_size <= page_size_min() || page_begin >= m_Size)
+			return false;
+		state.m_LastAccess[page_index] = state.m_Operation;  // Do not retry incompressible pages right away
+		state.m_Scratch.resize(page_size / 2);
+		const auto handle = m_Pages[page_index];
+		const auto compressed_size = lz_compress(m_PagePool.PtrFromHandle(handle), std::min(page_size, m_Size - page_begin), state.m_Scratch.data(), state.m_Scratch.size());
+		if (!compressed_size)
+			return false;
+		const auto compressed_bits = std::max(m_PagePool.PageSizeMinBits(), (unsigned char)std::bit_width(compressed_size - 1));
+		const auto compressed_handle = m_PagePool.Alloc(compressed_bits);
+		memcpy(m_PagePool.PtrFromHandle(compressed_handle), state.m_Scratch.data(), compressed_size);
+		m_PagePool.Free(handle);
+		m_Pages[page_index] = compressed_handle;
+		state.m_CompressedSizes[page_index] = (uint32_t)compressed_size;
+		return true;
+	}
+
+	void page_buffer::decompress_page(size_t page_index) const
+	{
+		auto& state = *m_Compression;
+		const auto compressed_handle = m_Pages[page_index];
+		const auto handle = m_PagePool.Alloc((unsigned char)std::countr_zero(m_Layout.page_size(page_index)));
+		size_t size;
+		if (!lz_decompress(m_PagePool.PtrFromHandle(compressed_handle), state.m_CompressedSizes[page_index], m_PagePool.PtrFromHandle(handle), m_Layout.page_size(page_index), size))
+		{
+			m_PagePool.Free(handle);
+			throw std::runtime_error("Corrupt compressed page in page buffer");
+		}
+		m_PagePool.Free(compressed_handle);
+		m_Pages[page_index] = handle;
+		state.m_CompressedSizes[page_index] = 0;
+	}
+
+	// page_buffer_snapshot
+
+	page_buffer_snapshot::state::~state()
+	{
+		for (size_t i = 0; i < m_Pages.size(); ++i)
+		{
+			if (m_OwnedPages[i])
+				m_PagePool->Free(m_Pages[i]);
+		}
+	}
+
+	size_t page_buffer_snapshot::read(size_t offset, void* buffer, size_t buffer_size) const
+	{
+		char* p = (char*)buffer;
+		for_each_segment(offset, buffer_size, [&](const void* segment, size_t n)
+		{
+			memcpy(p, segment, n);
+			p += n;
+		});
+		return p - (char*)buffer;
+	}
 }
 
 //#include "PageBufferStream.h"
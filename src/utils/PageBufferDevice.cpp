@@ -0,0 +1,93 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdexcept>
+#include <string>
+
+#include <QtCore/qfiledevice.h>
+
+#include <qapplib/utils/PageBuffer.h>
+
+namespace qapp
+{
+	static std::runtime_error device_error(const char* what, const QIODevice& device)
+	{
+		return std::runtime_error(std::string(what) + device.errorString().toStdString());
+	}
+
+	size_t page_buffer::write_to(QIODevice& device, size_t offset, size_t size) const
+	{
+#ifndef _WIN32
+		auto* file = qobject_cast<QFileDevice*>(&device);
+		if (file && file->handle() >= 0 && !file->isSequential())
+		{
+			if (!file->flush())
+				throw device_error("Failed to write page buffer: ", device);
+			const auto pos = file->pos();
+			const auto n = write_to(file->handle(), offset, size, pos);
+			if (!file->seek(pos + (qint64)n))
+				throw device_error("Failed to write page buffer: ", device);
+			return n;
+		}
+#endif
+		size_t total = 0;
+		for_each_segment(offset, size, [&](const void* data, size_t n)
+			{
+				if (device.write((const char*)data, (qint64)n) != (qint64)n)
+					throw device_error("Failed to write page buffer: ", device);
+				total += n;
+			});
+		return total;
+	}
+
+	size_t page_buffer::read_from(QIODevice& device, size_t offset, size_t size)
+	{
+#ifndef _WIN32
+		auto* file = qobject_cast<QFileDevice*>(&device);
+		if (file && file->handle() >= 0 && !file->isSequential())
+		{
+			// The device position accounts for data buffered by the device, which the seek below discards
+			const auto pos = file->pos();
+			const auto n = read_from(file->handle(), offset, size, pos);
+			if (!file->seek(pos + (qint64)n))
+				throw device_error("Failed to read page buffer: ", device);
+			return n;
+		}
+#endif
+		reserve(offset + size);
+		if (m_Compression)
+			on_operation();
+		size_t total = 0;
+		while (total < size)
+		{
+			size_t n;
+			auto* data = writable_page_ptr(offset + total, n);
+			n = std::min(n, size - total);
+			const auto num_bytes_read = device.read((char*)data, (qint64)n);
+			if (num_bytes_read < 0)
+				throw device_error("Failed to read page buffer: ", device);
+			total += num_bytes_read;
+			if ((size_t)num_bytes_read < n)
+				break;
+		}
+		m_Size = std::max(m_Size, offset + total);
+		trim_capacity();
+		return total;
+	}
+}
\ No newline at end of file
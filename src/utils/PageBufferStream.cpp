@@ -18,62 +18,122 @@ along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <algorithm>
+#include <cstring>
+#include <type_traits>
 #include <qapplib/Debug.h>
 #include <qapplib/utils/PageBufferStream.h>
+#include <qapplib/utils/SharedPageBuffer.h>
 
 namespace qapp
 {
-	// page_buffer_istream
+	// basic_page_istream
 
-	page_buffer_istream::page_buffer_istream(const page_buffer& buffer, size_t beg, size_t end)
+	template <class TBuffer>
+	basic_page_istream<TBuffer>::basic_page_istream(const TBuffer& buffer, size_t beg, size_t end)
 		: std::istream(&m_StreamBuf)
 		, m_StreamBuf(buffer, beg, end)
 	{
 	}
 
-	page_buffer_istream::streambuf::streambuf(const page_buffer& buffer, size_t beg, size_t end)
+	template <class TBuffer>
+	basic_page_istream<TBuffer>::streambuf::streambuf(const TBuffer& buffer, size_t beg, size_t end)
 		: m_Buffer(&buffer)
 		, m_Beg(beg)
 		, m_Cur(beg)
 		, m_End(end)
 	{}
 
-	std::streamsize page_buffer_istream::streambuf::xsgetn(char* s, std::streamsize n)
+	template <class TBuffer>
+	basic_page_istream<TBuffer>::streambuf::~streambuf()
 	{
-		const auto num_bytes_read = m_Buffer->read(m_Cur, s, std::min((size_t)n, m_End - m_Cur));
-		m_Cur += num_bytes_read;
+		drop_get_area();
+	}
+
+	template <class TBuffer>
+	std::streamsize basic_page_istream<TBuffer>::streambuf::xsgetn(char* s, std::streamsize n)
+	{
+		// Bypass the get area, read copies whole segments at a time
+		const auto pos = position();
+		const auto num_bytes_read = m_Buffer->read(pos, s, std::min((size_t)n, m_End - pos));
+		drop_get_area();
+		m_Cur = pos + num_bytes_read;
 		return num_bytes_read;
 	}
 
-	std::streambuf::int_type page_buffer_istream::streambuf::underflow()
+	template <class TBuffer>
+	std::streambuf::int_type basic_page_istream<TBuffer>::streambuf::underflow()
 	{
-		if (m_Cur >= m_End)
-			return EOF;
-		char c;
-		m_Buffer->read(m_Cur, &c, 1);
-		return (m_Buffer->read(m_Cur, &c, 1) == 1) ? traits_type::to_int_type(c) : EOF;
+		// The buffer may be smaller than the stream range, the range then ends with the buffer like read() does
+		const auto pos = position();
+		const auto end = std::min(m_End, m_Buffer->size());
+		drop_get_area();
+		m_Cur = pos;
+		if (pos >= end)
+			return traits_type::eof();
+		m_Buffer->for_each_segment(pos, end - pos, [&](const void* data, size_t size)
+			{
+				auto* p = (char*)data;
+				setg(p, p, p + size);
+				return false;
+			});
+		if (!gptr())
+			return traits_type::eof();
+		if constexpr (std::is_same_v<TBuffer, page_buffer>)
+		{
+			// Compression would free the page under the get area
+			m_Buffer->pin_page(m_Cur);
+			m_Pinned = true;
+		}
+		return traits_type::to_int_type(*gptr());
 	}
 
-	std::streampos page_buffer_istream::streambuf::seekoff(std::streamoff off, ios_base::seekdir way, ios_base::openmode which)
+	template <class TBuffer>
+	std::streampos basic_page_istream<TBuffer>::streambuf::seekoff(std::streamoff off, ios_base::seekdir way, ios_base::openmode which)
 	{
 		QAPP_ASSERT(ios_base::in == which);
 		std::streampos sp = 0;
 		switch (way)
 		{
 		case ios_base::beg: sp = 0; break;
-		case ios_base::cur: sp = (std::streampos)m_Cur - (std::streampos)m_Beg; break;
+		case ios_base::cur: sp = (std::streampos)position() - (std::streampos)m_Beg; break;
 		case ios_base::end: sp = m_End - m_Beg; break;
 		}
 		return seekpos(sp + off, which);
 	}
 
-	std::streampos page_buffer_istream::streambuf::seekpos(std::streampos sp, ios_base::openmode which)
+	template <class TBuffer>
+	std::streampos basic_page_istream<TBuffer>::streambuf::seekpos(std::streampos sp, ios_base::openmode which)
 	{
 		QAPP_ASSERT(ios_base::in == which);
+		drop_get_area();
 		m_Cur = std::min((std::streampos)m_Beg + std::max((std::streampos)0, sp), (std::streampos)m_End);
 		return m_Cur - m_Beg;
 	}
 
+	template <class TBuffer>
+	size_t basic_page_istream<TBuffer>::streambuf::position() const
+	{
+		return m_Cur + (gptr() - eback());
+	}
+
+	template <class TBuffer>
+	void basic_page_istream<TBuffer>::streambuf::drop_get_area()
+	{
+		if constexpr (std::is_same_v<TBuffer, page_buffer>)
+		{
+			if (m_Pinned)
+				m_Buffer->unpin_page(m_Cur);
+		}
+		m_Pinned = false;
+		setg(nullptr, nullptr, nullptr);
+	}
+
+	template class basic_page_istream<page_buffer>;
+	template class basic_page_istream<page_rope>;
+	#ifdef __linux__
+		template class basic_page_istream<shared_page_buffer_view>;
+	#endif
+
 
 	// page_buffer_ostream
 
@@ -89,8 +149,20 @@ namespace qapp
 		, m_Cur(beg)
 	{}
 
+	page_buffer_ostream::streambuf::~streambuf()
+	{
+		sync();
+	}
+
 	std::streamsize page_buffer_ostream::streambuf::xsputn(const char* s, std::streamsize n)
 	{
+		if (pptr() && n <= epptr() - pptr())
+		{
+			memcpy(pptr(), s, n);
+			pbump((int)n);
+			return n;
+		}
+		sync();
 		m_Buffer->write(m_Cur, s, n);
 		m_Cur += n;
 		return n;
@@ -98,9 +170,41 @@ namespace qapp
 
 	std::streambuf::int_type page_buffer_ostream::streambuf::overflow(std::streambuf::int_type c)
 	{
-		char tmp = c;
-		m_Buffer->write(m_Cur, &tmp, 1);
-		return traits_type::to_int_type(c);
+		sync();
+		size_t size;
+		auto* p = (char*)m_Buffer->writable_page_at(m_Cur, size);
+		setp(p, p + size);
+		// Compression would free the page under the put area, and snapshots and hashes must not miss its writes
+		m_Buffer->pin_page(m_Cur);
+		m_Buffer->add_writer(this);
+		m_Attached = true;
+		if (!traits_type::eq_int_type(c, traits_type::eof()))
+		{
+			*p = traits_type::to_char_type(c);
+			pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+
+	int page_buffer_ostream::streambuf::sync()
+	{
+		// Publish the bytes written to the put area since the last sync and drop it, the page is made writable again
+		// on the next write. Without new bytes the buffer is left alone, it may have been truncated in the meantime.
+		if (pptr() != pbase())
+		{
+			const auto pos = position();
+			if (pos > m_Buffer->size())
+				m_Buffer->resize(pos);
+		}
+		if (m_Attached)
+		{
+			m_Buffer->unpin_page(m_Cur);
+			m_Buffer->remove_writer(this);
+		}
+		m_Attached = false;
+		m_Cur = position();
+		setp(nullptr, nullptr);
+		return 0;
 	}
 
 	std::streampos page_buffer_ostream::streambuf::seekoff(std::streamoff off, ios_base::seekdir way, ios_base::openmode which)
@@ -110,8 +214,8 @@ namespace qapp
 		switch (way)
 		{
 		case ios_base::beg: sp = 0; break;
-		case ios_base::cur: sp = (std::streampos)m_Cur - (std::streampos)m_Beg; break;
-		case ios_base::end: sp = m_Buffer->size() - m_Beg; break;
+		case ios_base::cur: sp = (std::streampos)position() - (std::streampos)m_Beg; break;
+		case ios_base::end: sync(); sp = m_Buffer->size() - m_Beg; break;
 		}
 		return seekpos(sp + off, which);
 	}
@@ -119,7 +223,18 @@ namespace qapp
 	std::streampos page_buffer_ostream::streambuf::seekpos(std::streampos sp, ios_base::openmode which)
 	{
 		QAPP_ASSERT(ios_base::out == which);
+		sync();
 		m_Cur = m_Beg + std::max((std::streampos)0, sp);
 		return m_Cur - m_Beg;
 	}
+
+	size_t page_buffer_ostream::streambuf::position() const
+	{
+		return m_Cur + (pptr() - pbase());
+	}
+
+	void page_buffer_ostream::streambuf::detach()
+	{
+		sync();
+	}
 }
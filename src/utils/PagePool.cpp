@@ -17,41 +17,423 @@ You should have received a copy of the GNU Lesser General Public License
 along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <new>
+
 #include <qapplib/Debug.h>
 #include <qapplib/utils/PagePool.h>
 
 namespace qapp
 {
+	// Pages of a size class are cached per thread up to this many bytes, but at least THREAD_CACHE_MIN_PAGES and at
+	// most THREAD_CACHE_MAX_PAGES pages, so that large pages do not take the pool lock on every Alloc and Free
+	static const size_t THREAD_CACHE_CLASS_BYTES = 256 * 1024;
+	static const size_t THREAD_CACHE_MIN_PAGES = 2;
+	static const size_t THREAD_CACHE_MAX_PAGES = 32;
+
+	// Guards SThreadCache::m_Pool and CPagePool::m_ThreadCaches, i.e. the association between
+	// thread caches and pools. Only taken when a thread cache is created or destroyed.
+	static std::mutex s_ThreadCacheRegistryMutex;
+
+	struct CPagePool::SThreadCache
+	{
+		std::atomic<CPagePool*> m_Pool = nullptr;
+		std::vector<handle_t>   m_FreePages[16];
+	};
+
+	struct CPagePool::SThreadCacheList
+	{
+		~SThreadCacheList();
+
+		std::vector<std::unique_ptr<SThreadCache>> m_Caches;
+		SThreadCache* m_Last = nullptr;
+	};
+
+	CPagePool::SThreadCacheList::~SThreadCacheList()
+	{
+		std::lock_guard<std::mutex> registry_lock(s_ThreadCacheRegistryMutex);
+		for (auto& cache : m_Caches)
+		{
+			auto* pool = cache->m_Pool.load(std::memory_order_relaxed);
+			if (!pool)
+				continue;
+			for (size_t i = 0; i < std::size(cache->m_FreePages); ++i)
+				pool->FlushThreadCache(*cache, (unsigned char)i, 0);
+			auto& pool_caches = pool->m_ThreadCaches;
+			pool_caches.erase(std::find(pool_caches.begin(), pool_caches.end(), cache.get()));
+		}
+	}
+
 	CPagePool* CPagePool::s_DefaultPagePool = nullptr;
 
-	CPagePool::CPagePool(IPageAllocator& page_allocator, unsigned char page_size_min_bits)
+	CPagePool::CPagePool(IPageAllocator& page_allocator, unsigned char page_size_min_bits, EThreading threading)
 		: m_PageAllocator(page_allocator)
 		, m_PageSizeMinBits(page_size_min_bits)
 		, m_PageSizeMaxBits((unsigned char)std::countr_zero(page_allocator.PageSize()))
+		, m_Threading(threading)
 	{
-		QAPP_ASSERT(PageSizeMaxBits() - PageSizeMinBits() + 1 <= _countof(m_FreePages));
+		QAPP_ASSERT((size_t)(PageSizeMaxBits() - PageSizeMinBits() + 1) <= std::size(m_FreePages));
 	}
 
 	CPagePool::~CPagePool()
 	{
-		for (auto page : m_AllocatedPages)
-			m_PageAllocator.FreePage(page);
-		m_AllocatedPages.clear();
+		{
+			// Detach thread caches still referring to this pool, their pages are released below
+			std::lock_guard<std::mutex> registry_lock(s_ThreadCacheRegistryMutex);
+			for (auto* cache : m_ThreadCaches)
+			{
+				cache->m_Pool.store(nullptr, std::memory_order_relaxed);
+				for (auto& v : cache->m_FreePages)
+					v.clear();
+			}
+			m_ThreadCaches.clear();
+		}
+		for (auto& max_page : m_MaxPages)
+			m_PageAllocator.FreePage(max_page->m_Ptr);
+		m_MaxPages.clear();
 	}
 	
 	CPagePool::handle_t CPagePool::Alloc(unsigned char page_size_bits)
 	{
-		auto& v = m_FreePages[SizeIndexFromSizeBits(page_size_bits)];
+		QAPP_PAGE_POOL_STAT(CountAlloc(page_size_bits));
+
+		const auto handle = AllocUnchecked(page_size_bits);
+		if (!handle || m_SoftPressurePending.load(std::memory_order_relaxed))
+			return AllocUnderPressure(page_size_bits, handle);
+		return handle;
+	}
+
+	void CPagePool::Free(handle_t handle)
+	{
+		QAPP_PAGE_POOL_STAT(CountFree(handle));
+
+		if (EThreading::Single == m_Threading)
+			return FreeCentral(handle);
+
+		const auto page_size_bits = PageSizeBitsFromHandle(handle);
+		const auto capacity = ThreadCacheCapacity(page_size_bits);
+		auto& cache = ThreadCache();
+		const auto size_index = SizeIndexFromSizeBits(page_size_bits);
+		auto& v = cache.m_FreePages[size_index];
+		v.push_back(handle);
+		if (v.size() > capacity)
+			FlushThreadCache(cache, size_index, capacity / 2);
+	}
+
+	void CPagePool::SetBudget(size_t soft_limit_bytes, size_t hard_limit_bytes)
+	{
+		const auto lock = LockIfConcurrent();
+		m_SoftLimit = soft_limit_bytes;
+		m_HardLimit = hard_limit_bytes;
+	}
+
+	int CPagePool::AddPressureCallback(pressure_callback_t callback)
+	{
+		std::lock_guard<std::mutex> lock(m_CallbackMutex);
+		const int id = ++m_LastPressureCallbackId;
+		m_PressureCallbacks.emplace_back(id, std::move(callback));
+		return id;
+	}
+
+	void CPagePool::RemovePressureCallback(int id)
+	{
+		std::lock_guard<std::mutex> lock(m_CallbackMutex);
+		std::erase_if(m_PressureCallbacks, [id](const auto& entry) { return entry.first == id; });
+	}
+
+	void CPagePool::NotifyPressure(EMemoryPressure pressure)
+	{
+		// Invoke the callbacks without holding any lock, they typically free pages of this pool
+		decltype(m_PressureCallbacks) callbacks;
+		{
+			std::lock_guard<std::mutex> lock(m_CallbackMutex);
+			callbacks = m_PressureCallbacks;
+		}
+		for (auto& entry : callbacks)
+			entry.second(pressure);
+	}
+
+	void CPagePool::FlushThreadCache()
+	{
+		if (EThreading::Single == m_Threading)
+			return;
+		auto& cache = ThreadCache();
+		for (size_t i = 0; i < std::size(cache.m_FreePages); ++i)
+			FlushThreadCache(cache, (unsigned char)i, 0);
+	}
+
+	size_t CPagePool::Trim(size_t target_bytes, bool decommit)
+	{
+		const auto lock = LockIfConcurrent();
+
+		MergeFreeMaxPages();
+		const auto page_size = PageSizeMax();
+		auto& v = m_FreePages[SizeIndexFromSizeBits(PageSizeMaxBits())];
+		size_t released = 0;
+		while (!v.empty() && m_MaxPages.size() * page_size > target_bytes)
+		{
+			ReleaseMaxPage(*v.front().m_MaxPage);
+			released += page_size;
+		}
+
+		if (decommit)
+		{
+			for (auto& page : v)
+			{
+				if (page.m_MaxPage->m_Decommitted)
+					continue;
+				m_PageAllocator.DecommitPage(page.m_MaxPage->m_Ptr);
+				page.m_MaxPage->m_Decommitted = true;
+			}
+		}
+
+		return released;
+	}
+
+	void CPagePool::Reserve(unsigned char page_size_bits, size_t count)
+	{
+		// Split bigger pages (or allocate max pages) until the free list plus the new pages hold count pages. The new
+		// pages stay out of the pool while they are prefaulted, so that the pool lock is not held while touching
+		// memory, no one else can be using them and MergeFreeMaxPages can not merge them away meanwhile.
+		std::vector<handle_t> pages;
+		{
+			const auto lock = LockIfConcurrent();
+			const auto& v = m_FreePages[SizeIndexFromSizeBits(page_size_bits)];
+			while (v.size() + pages.size() < count)
+			{
+				const auto page = page_size_bits == PageSizeMaxBits() ? AllocMaxPage() : AllocInternal(page_size_bits + 1);
+				if (!page.m_MaxPage)
+					break;
+				auto* ptr = PtrFromHandle(page.m_Handle);
+				pages.push_back(CreateHandle(ptr, page_size_bits));
+				if (page_size_bits < PageSizeMaxBits())
+				{
+					QAPP_PAGE_POOL_STAT(m_Counters[SizeIndexFromSizeBits(page_size_bits + 1)].m_Splits.fetch_add(1, std::memory_order_relaxed));
+					pages.push_back(CreateHandle((char*)ptr + SizeFromBits(page_size_bits), page_size_bits));
+				}
+			}
+		}
+
+		for (auto handle : pages)
+			prefault_pages(PtrFromHandle(handle), PageSize(handle));
+
+		// Put the pages back without merging, merging would undo the splits. Max pages left entirely free are merged
+		// by MergeFreeMaxPages when needed.
+		const auto lock = LockIfConcurrent();
+		m_HasUnmergedPages |= page_size_bits < PageSizeMaxBits() && !pages.empty();
+		for (auto handle : pages)
+		{
+			auto* ptr = PtrFromHandle(handle);
+			PushFreePage(MaxPageFromPtr(ptr), ptr, page_size_bits);
+		}
+	}
+
+	void CPagePool::Prewarm(size_t bytes)
+	{
+		Reserve(PageSizeMaxBits(), (bytes + PageSizeMax() - 1) >> PageSizeMaxBits());
+	}
+
+	std::future<void> CPagePool::PrewarmAsync(size_t bytes)
+	{
+		QAPP_ASSERT(EThreading::Concurrent == m_Threading);
+		return std::async(std::launch::async, [this, bytes]() { Prewarm(bytes); });
+	}
+
+	void CPagePool::SetIdleLimit(size_t idle_limit_bytes)
+	{
+		const auto lock = LockIfConcurrent();
+
+		m_IdleLimit = idle_limit_bytes;
+		MergeFreeMaxPages();
+		auto& v = m_FreePages[SizeIndexFromSizeBits(PageSizeMaxBits())];
+		while (!v.empty() && v.size() * PageSizeMax() > m_IdleLimit)
+			ReleaseMaxPage(*v.front().m_MaxPage);
+	}
+
+	size_t CPagePool::AllocatedBytes() const
+	{
+		const auto lock = LockIfConcurrent();
+		return m_MaxPages.size() * PageSizeMax();
+	}
+
+	SPagePoolStats CPagePool::Stats() const
+	{
+		const auto lock = LockIfConcurrent();
+		SPagePoolStats stats;
+		stats.m_AllocatedBytes = m_MaxPages.size() * PageSizeMax();
+		QAPP_PAGE_POOL_STAT(stats.m_PeakAllocatedBytes = m_PeakAllocatedBytes);
+		for (unsigned char bits = PageSizeMinBits(); bits <= PageSizeMaxBits(); ++bits)
+		{
+			const auto size_index = SizeIndexFromSizeBits(bits);
+			auto& size_class = stats.m_SizeClasses.emplace_back();
+			size_class.m_SizeBits = bits;
+			size_class.m_FreeListLength = m_FreePages[size_index].size();
+			#ifdef QAPP_PAGE_POOL_STATS
+				const auto& counters = m_Counters[size_index];
+				size_class.m_Allocs = counters.m_Allocs.load(std::memory_order_relaxed);
+				size_class.m_Frees = counters.m_Frees.load(std::memory_order_relaxed);
+				size_class.m_Splits = counters.m_Splits.load(std::memory_order_relaxed);
+				size_class.m_Merges = counters.m_Merges.load(std::memory_order_relaxed);
+				size_class.m_Live = counters.m_Live.load(std::memory_order_relaxed);
+				size_class.m_PeakLive = counters.m_PeakLive.load(std::memory_order_relaxed);
+			#endif
+		}
+		return stats;
+	}
+
+	#ifdef QAPP_PAGE_POOL_STATS
+		void CPagePool::CountAlloc(unsigned char page_size_bits)
+		{
+			auto& counters = m_Counters[SizeIndexFromSizeBits(page_size_bits)];
+			counters.m_Allocs.fetch_add(1, std::memory_order_relaxed);
+			const auto live = counters.m_Live.fetch_add(1, std::memory_order_relaxed) + 1;
+			auto peak = counters.m_PeakLive.load(std::memory_order_relaxed);
+			while (live > peak && !counters.m_PeakLive.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+		}
+
+		void CPagePool::CountFree(handle_t handle)
+		{
+			auto& counters = m_Counters[SizeIndexFromSizeBits(PageSizeBitsFromHandle(handle))];
+			counters.m_Frees.fetch_add(1, std::memory_order_relaxed);
+			counters.m_Live.fetch_sub(1, std::memory_order_relaxed);
+		}
+	#endif
+
+	CPagePool::handle_t CPagePool::AllocUnchecked(unsigned char page_size_bits)
+	{
+		if (EThreading::Single == m_Threading)
+			return AllocCentral(page_size_bits);
+
+		const auto size_index = SizeIndexFromSizeBits(page_size_bits);
+		const auto capacity = ThreadCacheCapacity(page_size_bits);
+		auto& v = ThreadCache().m_FreePages[size_index];
 		if (v.empty())
-			return AllocInternal(page_size_bits);
+		{
+			// Refill half of the cache capacity in one go to amortize the locking
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			for (size_t n = (capacity + 1) / 2; n; --n)
+			{
+				const auto page_handle = AllocCentral(page_size_bits);
+				if (!page_handle)
+					break;
+				v.push_back(page_handle);
+			}
+			if (v.empty())
+				return nullptr;
+		}
 		const auto page_handle = v.back();
 		v.pop_back();
 		return page_handle;
 	}
 
-	void CPagePool::Free(handle_t handle)
+	CPagePool::handle_t CPagePool::AllocUnderPressure(unsigned char page_size_bits, handle_t handle)
+	{
+		if (m_SoftPressurePending.exchange(false, std::memory_order_relaxed))
+			NotifyPressure(EMemoryPressure::Soft);
+		if (handle)
+			return handle;
+
+		// The hard limit would be exceeded, give the callbacks a chance to free pages before giving up
+		NotifyPressure(EMemoryPressure::Hard);
+		FlushThreadCache();
+		handle = AllocUnchecked(page_size_bits);
+		if (!handle)
+			throw std::bad_alloc();
+		return handle;
+	}
+
+	CPagePool::SThreadCacheList& CPagePool::ThreadCacheList()
+	{
+		thread_local SThreadCacheList list;
+		return list;
+	}
+
+	CPagePool::SThreadCache& CPagePool::ThreadCache()
+	{
+		auto& list = ThreadCacheList();
+		if (list.m_Last && list.m_Last->m_Pool.load(std::memory_order_relaxed) == this)
+			return *list.m_Last;
+
+		for (auto& cache : list.m_Caches)
+		{
+			if (cache->m_Pool.load(std::memory_order_relaxed) == this)
+			{
+				list.m_Last = cache.get();
+				return *cache;
+			}
+		}
+
+		std::lock_guard<std::mutex> registry_lock(s_ThreadCacheRegistryMutex);
+
+		// Drop caches of pools that have been destroyed
+		std::erase_if(list.m_Caches, [](const auto& cache) { return !cache->m_Pool.load(std::memory_order_relaxed); });
+
+		auto cache = std::make_unique<SThreadCache>();
+		cache->m_Pool.store(this, std::memory_order_relaxed);
+		for (unsigned char bits = PageSizeMinBits(); bits <= PageSizeMaxBits(); ++bits)
+			cache->m_FreePages[SizeIndexFromSizeBits(bits)].reserve(ThreadCacheCapacity(bits) + 1);
+		m_ThreadCaches.push_back(cache.get());
+		list.m_Last = cache.get();
+		list.m_Caches.push_back(std::move(cache));
+		return *list.m_Last;
+	}
+
+	void CPagePool::FlushThreadCache(SThreadCache& cache, unsigned char size_index, size_t keep_count)
 	{
-		m_FreePages[SizeIndexFromSizeBits(PageSizeBitsFromHandle(handle))].push_back(handle);
+		auto& v = cache.m_FreePages[size_index];
+		if (v.size() <= keep_count)
+			return;
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		while (v.size() > keep_count)
+		{
+			FreeCentral(v.back());
+			v.pop_back();
+		}
+	}
+
+	size_t CPagePool::ThreadCacheCapacity(unsigned char page_size_bits)
+	{
+		return std::clamp(THREAD_CACHE_CLASS_BYTES >> page_size_bits, THREAD_CACHE_MIN_PAGES, THREAD_CACHE_MAX_PAGES);
+	}
+
+	std::unique_lock<std::mutex> CPagePool::LockIfConcurrent() const
+	{
+		if (EThreading::Concurrent == m_Threading)
+			return std::unique_lock<std::mutex>(m_Mutex);
+		return std::unique_lock<std::mutex>(m_Mutex, std::defer_lock);
+	}
+
+	CPagePool::handle_t CPagePool::AllocCentral(unsigned char page_size_bits)
+	{
+		const auto page = AllocInternal(page_size_bits);
+		return page.m_MaxPage ? page.m_Handle : nullptr;
+	}
+
+	void CPagePool::FreeCentral(handle_t handle)
+	{
+		auto page_size_bits = PageSizeBitsFromHandle(handle);
+		auto* ptr = PtrFromHandle(handle);
+		auto& max_page = MaxPageFromPtr(ptr);
+
+		// Merge with the buddy for as long as it is free
+		for (; page_size_bits < PageSizeMaxBits(); ++page_size_bits)
+		{
+			const auto node = NodeFromPtr(max_page, ptr, page_size_bits);
+			if (!TestNode(max_page, node ^ 1))
+				break;
+			const auto offset = (size_t)((char*)ptr - (char*)max_page.m_Ptr);
+			auto* buddy_ptr = (char*)max_page.m_Ptr + (offset ^ SizeFromBits(page_size_bits));
+			RemoveFreePage(max_page, buddy_ptr, page_size_bits);
+			QAPP_PAGE_POOL_STAT(m_Counters[SizeIndexFromSizeBits(page_size_bits)].m_Merges.fetch_add(1, std::memory_order_relaxed));
+			ptr = std::min((char*)ptr, buddy_ptr);
+		}
+
+		PushFreePage(max_page, ptr, page_size_bits);
+
+		if (page_size_bits == PageSizeMaxBits() && m_FreePages[SizeIndexFromSizeBits(page_size_bits)].size() * PageSizeMax() > m_IdleLimit)
+			ReleaseMaxPage(max_page);
 	}
 
 	unsigned char CPagePool::SizeIndexFromSizeBits(unsigned char size_bits) const
@@ -73,18 +455,144 @@ namespace qapp
 		return (void*)(reinterpret_cast<uintptr_t>(ptr) | SizeIndexFromSizeBits(page_size_bits));
 	}
 
-	CPagePool::handle_t CPagePool::AllocInternal(unsigned char page_size_bits)
+	CPagePool::SFreePage CPagePool::AllocInternal(unsigned char page_size_bits)
 	{
+		auto& v = m_FreePages[SizeIndexFromSizeBits(page_size_bits)];
+		if (v.empty() && page_size_bits == PageSizeMaxBits())
+			MergeFreeMaxPages();
+		if (!v.empty())
+		{
+			const auto page = v.back();
+			v.pop_back();
+			const auto node = NodeFromPtr(*page.m_MaxPage, PtrFromHandle(page.m_Handle), page_size_bits);
+			page.m_MaxPage->m_FreeNodes[node >> 6] &= ~((uint64_t)1 << (node & 63));
+			page.m_MaxPage->m_Decommitted = false;
+			return page;
+		}
+
 		if (page_size_bits == PageSizeMaxBits())
+			return AllocMaxPage();
+
+		const auto parent = AllocInternal(page_size_bits + 1);
+		if (!parent.m_MaxPage)
+			return parent;
+		QAPP_PAGE_POOL_STAT(m_Counters[SizeIndexFromSizeBits(page_size_bits + 1)].m_Splits.fetch_add(1, std::memory_order_relaxed));
+		const auto parent_ptr = PtrFromHandle(parent.m_Handle);
+		PushFreePage(*parent.m_MaxPage, (char*)parent_ptr + SizeFromBits(page_size_bits), page_size_bits);
+		return { CreateHandle(parent_ptr, page_size_bits), parent.m_MaxPage };
+	}
+
+	CPagePool::SFreePage CPagePool::AllocMaxPage()
+	{
+		const auto allocated_bytes = (m_MaxPages.size() + 1) * PageSizeMax();
+		if (allocated_bytes > m_HardLimit)
+			return { nullptr, nullptr };
+		if (allocated_bytes > m_SoftLimit)
+			m_SoftPressurePending.store(true, std::memory_order_relaxed);
+
+		auto* ptr = m_PageAllocator.AllocPage();
+		const auto node_count = (size_t)2 << (PageSizeMaxBits() - PageSizeMinBits());
+		auto max_page = std::make_unique<SMaxPage>();
+		max_page->m_Ptr = ptr;
+		max_page->m_FreeNodes.resize((node_count + 63) / 64);
+		max_page->m_FreeListPos.resize(node_count / 2);
+		const auto it = std::upper_bound(m_MaxPages.begin(), m_MaxPages.end(), ptr, [](const void* p, const auto& mp) { return p < mp->m_Ptr; });
+		const SFreePage page{ CreateHandle(ptr, PageSizeMaxBits()), max_page.get() };
+		m_MaxPages.insert(it, std::move(max_page));
+		QAPP_PAGE_POOL_STAT(m_PeakAllocatedBytes = std::max(m_PeakAllocatedBytes, m_MaxPages.size() * PageSizeMax()));
+		return page;
+	}
+
+	void CPagePool::ReleaseMaxPage(SMaxPage& max_page)
+	{
+		RemoveFreePage(max_page, max_page.m_Ptr, PageSizeMaxBits());
+		m_PageAllocator.FreePage(max_page.m_Ptr);
+		const auto it = std::lower_bound(m_MaxPages.begin(), m_MaxPages.end(), max_page.m_Ptr, [](const auto& mp, const void* p) { return mp->m_Ptr < p; });
+		QAPP_ASSERT(it != m_MaxPages.end() && it->get() == &max_page);
+		m_MaxPages.erase(it);
+	}
+
+	void CPagePool::MergeFreeMaxPages()
+	{
+		if (!m_HasUnmergedPages)
+			return;
+		m_HasUnmergedPages = false;
+		for (auto& max_page : m_MaxPages)
 		{
-			auto* ptr = m_PageAllocator.AllocPage();
-			return CreateHandle(ptr, page_size_bits);
+			if (TestNode(*max_page, 1))
+				continue;
+			if (!IsSubtreeFree(*max_page, 1, PageSizeMaxBits()))
+			{
+				// Possibly still holding unmerged reserved pages
+				m_HasUnmergedPages = true;
+				continue;
+			}
+			RemoveFreeSubtree(*max_page, 1, PageSizeMaxBits());
+			PushFreePage(*max_page, max_page->m_Ptr, PageSizeMaxBits());
 		}
-		const auto parent_handle = Alloc(page_size_bits + 1);
-		const auto parent_ptr = PtrFromHandle(parent_handle);
-		if (page_size_bits + 1 == PageSizeMaxBits())
-			m_AllocatedPages.push_back(parent_ptr);
-		m_FreePages[SizeIndexFromSizeBits(page_size_bits)].push_back(CreateHandle((char*)parent_ptr + SizeFromBits(page_size_bits), page_size_bits));
-		return CreateHandle((char*)parent_ptr, page_size_bits);
+	}
+
+	bool CPagePool::IsSubtreeFree(const SMaxPage& max_page, size_t node, unsigned char page_size_bits) const
+	{
+		if (TestNode(max_page, node))
+			return true;
+		if (page_size_bits == PageSizeMinBits())
+			return false;
+		return IsSubtreeFree(max_page, node * 2, page_size_bits - 1) && IsSubtreeFree(max_page, node * 2 + 1, page_size_bits - 1);
+	}
+
+	void CPagePool::RemoveFreeSubtree(SMaxPage& max_page, size_t node, unsigned char page_size_bits)
+	{
+		if (TestNode(max_page, node))
+		{
+			const auto offset = (node - ((size_t)1 << (PageSizeMaxBits() - page_size_bits))) << page_size_bits;
+			RemoveFreePage(max_page, (char*)max_page.m_Ptr + offset, page_size_bits);
+			return;
+		}
+		RemoveFreeSubtree(max_page, node * 2, page_size_bits - 1);
+		RemoveFreeSubtree(max_page, node * 2 + 1, page_size_bits - 1);
+	}
+
+	CPagePool::SMaxPage& CPagePool::MaxPageFromPtr(const void* ptr) const
+	{
+		const auto it = std::upper_bound(m_MaxPages.begin(), m_MaxPages.end(), ptr, [](const void* p, const auto& mp) { return p < mp->m_Ptr; });
+		QAPP_ASSERT(it != m_MaxPages.begin());
+		auto& max_page = **(it - 1);
+		QAPP_ASSERT((const char*)ptr < (const char*)max_page.m_Ptr + PageSizeMax());
+		return max_page;
+	}
+
+	size_t CPagePool::NodeFromPtr(const SMaxPage& max_page, const void* ptr, unsigned char page_size_bits) const
+	{
+		const auto offset = (size_t)((const char*)ptr - (const char*)max_page.m_Ptr);
+		return ((size_t)1 << (PageSizeMaxBits() - page_size_bits)) | (offset >> page_size_bits);
+	}
+
+	size_t CPagePool::MinPageIndexFromPtr(const SMaxPage& max_page, const void* ptr) const
+	{
+		return (size_t)((const char*)ptr - (const char*)max_page.m_Ptr) >> PageSizeMinBits();
+	}
+
+	void CPagePool::PushFreePage(SMaxPage& max_page, void* ptr, unsigned char page_size_bits)
+	{
+		const auto node = NodeFromPtr(max_page, ptr, page_size_bits);
+		QAPP_ASSERT(!TestNode(max_page, node));
+		auto& v = m_FreePages[SizeIndexFromSizeBits(page_size_bits)];
+		max_page.m_FreeNodes[node >> 6] |= (uint64_t)1 << (node & 63);
+		max_page.m_FreeListPos[MinPageIndexFromPtr(max_page, ptr)] = (uint32_t)v.size();
+		v.push_back({ CreateHandle(ptr, page_size_bits), &max_page });
+	}
+
+	void CPagePool::RemoveFreePage(SMaxPage& max_page, void* ptr, unsigned char page_size_bits)
+	{
+		const auto node = NodeFromPtr(max_page, ptr, page_size_bits);
+		QAPP_ASSERT(TestNode(max_page, node));
+		auto& v = m_FreePages[SizeIndexFromSizeBits(page_size_bits)];
+		const auto pos = max_page.m_FreeListPos[MinPageIndexFromPtr(max_page, ptr)];
+		const auto moved = v.back();
+		v[pos] = moved;
+		moved.m_MaxPage->m_FreeListPos[MinPageIndexFromPtr(*moved.m_MaxPage, PtrFromHandle(moved.m_Handle))] = pos;
+		v.pop_back();
+		max_page.m_FreeNodes[node >> 6] &= ~((uint64_t)1 << (node & 63));
 	}
 }
\ No newline at end of file
@@ -0,0 +1,279 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <qapplib/Debug.h>
+#include <qapplib/utils/ByteSearch.h>
+#include <qapplib/utils/PageRope.h>
+
+namespace qapp
+{
+	page_rope::page_rope(CPagePool& page_pool, unsigned char leaf_size_bits)
+		: m_PagePool(page_pool)
+		, m_LeafSizeBits(leaf_size_bits ? leaf_size_bits : page_pool.PageSizeMinBits())
+		, m_Nodes(std::make_unique<page_slab<node>>(page_pool))
+	{
+		QAPP_ASSERT(m_LeafSizeBits >= m_PagePool.PageSizeMinBits() && m_LeafSizeBits <= m_PagePool.PageSizeMaxBits());
+	}
+
+	page_rope::page_rope(page_rope&& other)
+		: m_PagePool(other.m_PagePool)
+		, m_LeafSizeBits(other.m_LeafSizeBits)
+		, m_Nodes(std::move(other.m_Nodes))
+		, m_Root(other.m_Root)
+		, m_Seed(other.m_Seed)
+	{
+		other.m_Nodes = std::make_unique<page_slab<node>>(m_PagePool);
+		other.m_Root = nullptr;
+	}
+
+	page_rope::~page_rope()
+	{
+		clear();
+	}
+
+	void page_rope::clear()
+	{
+		free_tree(m_Root);
+		m_Root = nullptr;
+		m_Nodes->clear();
+	}
+
+	void page_rope::insert(size_t offset, const void* data, size_t size)
+	{
+		QAPP_ASSERT(offset <= this->size());
+		if (!size)
+			return;
+
+		// Fits in the leaf holding offset, or the one ending there
+		if (m_Root)
+		{
+			auto leaf_offset = offset;
+			auto* leaf = find_leaf(leaf_offset, 0);
+			if (leaf->m_Size + size <= leaf_size())
+			{
+				leaf_offset = offset;
+				find_leaf(leaf_offset, (ptrdiff_t)size);
+				auto* p = leaf_ptr(leaf) + leaf_offset;
+				memmove(p + size, p, leaf->m_Size - leaf_offset);
+				memcpy(p, data, size);
+				leaf->m_Size += (uint32_t)size;
+				return;
+			}
+		}
+
+		node* left;
+		node* right;
+		split(m_Root, offset, left, right);
+		node* middle = nullptr;
+		for (size_t pos = 0; pos < size; pos += leaf_size())
+			middle = merge(middle, new_leaf((const char*)data + pos, std::min(leaf_size(), size - pos)));
+		m_Root = join(join(left, middle), right);
+	}
+
+	void page_rope::append(const void* data, size_t size)
+	{
+		insert(this->size(), data, size);
+	}
+
+	void page_rope::erase(size_t offset, size_t size)
+	{
+		if (offset >= this->size())
+			return;
+		size = std::min(size, this->size() - offset);
+		if (!size)
+			return;
+
+		// Within a single leaf that keeps some of its bytes. The leaf ending at offset + 1 holds the byte at offset.
+		auto leaf_offset = offset + 1;
+		auto* leaf = find_leaf(leaf_offset, 0);
+		--leaf_offset;
+		if (leaf_offset + size <= leaf->m_Size && size < leaf->m_Size)
+		{
+			auto path_offset = offset + 1;
+			find_leaf(path_offset, -(ptrdiff_t)size);
+			auto* p = leaf_ptr(leaf) + leaf_offset;
+			memmove(p, p + size, leaf->m_Size - leaf_offset - size);
+			leaf->m_Size -= (uint32_t)size;
+			return;
+		}
+
+		node* left;
+		node* middle;
+		node* right;
+		split(m_Root, offset, left, middle);
+		split(middle, size, middle, right);
+		free_tree(middle);
+		m_Root = join(left, right);
+	}
+
+	size_t page_rope::read(size_t offset, void* buffer, size_t buffer_size) const
+	{
+		char* p = (char*)buffer;
+		for_each_segment(offset, buffer_size, [&](const void* segment, size_t n)
+		{
+			memcpy(p, segment, n);
+			p += n;
+		});
+		return p - (char*)buffer;
+	}
+
+	size_t page_rope::find(uint8_t byte, size_t offset) const
+	{
+		return find_byte_in(*this, offset, byte);
+	}
+
+	size_t page_rope::find(const void* pattern, size_t pattern_size, size_t offset) const
+	{
+		return find_pattern_in(*this, offset, pattern, pattern_size);
+	}
+
+	size_t page_rope::count(uint8_t byte, size_t offset, size_t size) const
+	{
+		return count_byte_in(*this, offset, size, byte);
+	}
+
+	page_rope page_rope::substr(size_t offset, size_t size) const
+	{
+		page_rope rope(m_PagePool, m_LeafSizeBits);
+		for_each_segment(offset, size, [&](const void* segment, size_t n)
+		{
+			rope.append(segment, n);
+		});
+		return rope;
+	}
+
+	page_rope::node* page_rope::new_leaf(const void* data, size_t size)
+	{
+		auto* n = m_Nodes->New();
+		n->m_Leaf = m_PagePool.Alloc(m_LeafSizeBits);
+		m_Seed ^= m_Seed << 13;
+		m_Seed ^= m_Seed >> 17;
+		m_Seed ^= m_Seed << 5;
+		n->m_Priority = m_Seed;
+		n->m_Size = (uint32_t)size;
+		n->m_TreeSize = size;
+		memcpy(leaf_ptr(n), data, size);
+		return n;
+	}
+
+	void page_rope::free_tree(node* n)
+	{
+		if (!n)
+			return;
+		free_tree(n->m_Left);
+		free_tree(n->m_Right);
+		m_PagePool.Free(n->m_Leaf);
+		m_Nodes->Delete(n);
+	}
+
+	page_rope::node* page_rope::find_leaf(size_t& offset, ptrdiff_t tree_size_delta)
+	{
+		// Finds the leaf with offset in (leaf begin, leaf end], or the first leaf for offset 0. Adds
+		// tree_size_delta to the subtree size of every node on the way, for the caller to resize that leaf.
+		auto* n = m_Root;
+		for (;;)
+		{
+			n->m_TreeSize += tree_size_delta;
+			const auto left_size = tree_size(n->m_Left);
+			if (offset <= left_size && n->m_Left)
+			{
+				n = n->m_Left;
+				continue;
+			}
+			offset -= left_size;
+			if (offset <= n->m_Size)
+				return n;
+			offset -= n->m_Size;
+			n = n->m_Right;
+		}
+	}
+
+	page_rope::node* page_rope::merge(node* a, node* b)
+	{
+		if (!a)
+			return b;
+		if (!b)
+			return a;
+		if (a->m_Priority > b->m_Priority)
+		{
+			a->m_Right = merge(a->m_Right, b);
+			update(a);
+			return a;
+		}
+		b->m_Left = merge(a, b->m_Left);
+		update(b);
+		return b;
+	}
+
+	void page_rope::split(node* n, size_t offset, node*& ret_left, node*& ret_right)
+	{
+		if (!n)
+		{
+			ret_left = ret_right = nullptr;
+			return;
+		}
+		const auto left_size = tree_size(n->m_Left);
+		if (offset <= left_size)
+		{
+			split(n->m_Left, offset, ret_left, n->m_Left);
+			update(n);
+			ret_right = n;
+			return;
+		}
+		offset -= left_size;
+		if (offset < n->m_Size)
+		{
+			// Inside this leaf, its tail moves to a new leaf
+			auto* tail = new_leaf(leaf_ptr(n) + offset, n->m_Size - offset);
+			n->m_Size = (uint32_t)offset;
+			ret_right = merge(tail, n->m_Right);
+			n->m_Right = nullptr;
+		}
+		else
+			split(n->m_Right, offset - n->m_Size, n->m_Right, ret_right);
+		update(n);
+		ret_left = n;
+	}
+
+	page_rope::node* page_rope::join(node* a, node* b)
+	{
+		// Moves the first leaf of b into the last leaf of a when it fits, so that edits do not leave ever smaller
+		// leaves behind
+		if (!a || !b)
+			return merge(a, b);
+		auto* last = a;
+		while (last->m_Right)
+			last = last->m_Right;
+		auto* first = b;
+		while (first->m_Left)
+			first = first->m_Left;
+		if (last->m_Size + first->m_Size > leaf_size())
+			return merge(a, b);
+
+		node* rest;
+		split(b, first->m_Size, first, rest);
+		memcpy(leaf_ptr(last) + last->m_Size, leaf_ptr(first), first->m_Size);
+		last->m_Size += first->m_Size;
+		for (auto* n = a; n; n = n->m_Right)
+			n->m_TreeSize += first->m_Size;
+		free_tree(first);
+		return merge(a, rest);
+	}
+}
\ No newline at end of file
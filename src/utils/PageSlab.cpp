@@ -0,0 +1,66 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <bit>
+
+#include <qapplib/Debug.h>
+
+#include <qapplib/utils/Bits.h>
+#include <qapplib/utils/PageSlab.h>
+
+namespace qapp
+{
+	page_slab_base::page_slab_base(CPagePool& page_pool, size_t slot_size, size_t slot_alignment)
+		: m_PagePool(page_pool)
+		, m_SlotSize(align_up(std::max(slot_size, sizeof(void*)), std::max(slot_alignment, alignof(void*))))
+	{
+		QAPP_ASSERT(slot_alignment <= m_PagePool.PageSizeMin());
+		QAPP_ASSERT(m_SlotSize <= m_PagePool.PageSizeMax());
+	}
+
+	page_slab_base::~page_slab_base()
+	{
+		clear();
+	}
+
+	void page_slab_base::clear()
+	{
+		for (auto handle : m_Pages)
+			m_PagePool.Free(handle);
+		m_Pages.clear();
+		m_FreeList = nullptr;
+		m_Cur = m_End = nullptr;
+	}
+
+	void page_slab_base::add_page()
+	{
+		size_t page_size = m_Pages.empty() ?
+			m_PagePool.PageSizeMin() :
+			std::min(m_PagePool.PageSize(m_Pages.back()) * 2, m_PagePool.PageSizeMax());
+
+		page_size = std::max(std::bit_ceil(m_SlotSize), page_size);
+
+		const auto handle = m_PagePool.Alloc((unsigned char)std::countr_zero(page_size));
+		m_Pages.push_back(handle);
+
+		m_Cur = (char*)m_PagePool.PtrFromHandle(handle);
+		m_End = m_Cur + (page_size / m_SlotSize) * m_SlotSize;
+	}
+}
\ No newline at end of file
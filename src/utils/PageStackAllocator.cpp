@@ -19,15 +19,35 @@ along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 
 #include <algorithm>
 #include <bit>
-#include <stdexcept>
 
 #include <qapplib/Debug.h>
 
 #include <qapplib/utils/Bits.h>
+#include <qapplib/utils/PageAllocator.h>
 #include <qapplib/utils/PageStackAllocator.h>
 
 namespace qapp
 {
+	struct page_stack_allocator_base::finalizer
+	{
+		finalizer*    m_Prev;
+		finalize_fn_t m_Fn;
+		void*         m_Obj;
+		state_t       m_State;  // Allocator state before this record was allocated
+	};
+
+	// Mapping of an allocation larger than the max page size. The record lives in the arena and is unmapped through
+	// the finalizer chain, which also orders it with the pages for restore.
+	struct page_stack_allocator_base::large_block
+	{
+		page_stack_allocator_base* m_Allocator;
+		void*  m_Ptr;
+		size_t m_Size;
+	};
+
+	// Alignment of map_pages on every supported OS
+	static const size_t LARGE_BLOCK_ALIGNMENT = 4096;
+
 	page_stack_allocator_base::page_stack_allocator_base(CPagePool& page_pool)
 		: m_PagePool(page_pool)
 	{
@@ -40,6 +60,7 @@ namespace qapp
 
 	void page_stack_allocator_base::clear()
 	{
+		run_finalizers(0);
 		while (!m_Pages.empty())
 			pop_page();
 	}
@@ -53,6 +74,8 @@ namespace qapp
 			if (avail >= (ptrdiff_t)size)
 				return alloc_internal(page_offset, size);
 		}
+		if (size > m_PagePool.PageSizeMax())
+			return alloc_large(size, alignment);
 		add_page(size);
 		return alloc_internal(m_LastPageUsage, size);
 	}
@@ -62,14 +85,65 @@ namespace qapp
 		return (m_Pages.size() << 32) | m_LastPageUsage;
 	}
 
+	size_t page_stack_allocator_base::used_bytes() const
+	{
+		if (m_Pages.empty())
+			return m_LargeBytes;
+		return m_PageBytes - m_PagePool.PageSize(m_Pages.back()) + m_LastPageUsage + m_LargeBytes;
+	}
+
 	void page_stack_allocator_base::restore(state_t s)
 	{
+		run_finalizers(s);
 		const auto page_count = s >> 32;
 		while (m_Pages.size() > page_count)
 			pop_page();
 		m_LastPageUsage = (unsigned int)s;
 	}
 
+	page_stack_allocator_base::finalizer* page_stack_allocator_base::alloc_finalizer()
+	{
+		const auto s = state();
+		auto* f = (finalizer*)alloc(sizeof(finalizer), alignof(finalizer));
+		f->m_State = s;
+		return f;
+	}
+
+	void page_stack_allocator_base::push_finalizer(finalizer* f, void* obj, finalize_fn_t fn)
+	{
+		f->m_Prev = m_Finalizers;
+		f->m_Fn = fn;
+		f->m_Obj = obj;
+		m_Finalizers = f;
+	}
+
+	void page_stack_allocator_base::run_finalizers(state_t s)
+	{
+		while (m_Finalizers && m_Finalizers->m_State >= s)
+		{
+			auto* f = m_Finalizers;
+			m_Finalizers = f->m_Prev;
+			f->m_Fn(f->m_Obj);
+		}
+	}
+
+	void* page_stack_allocator_base::alloc_large(size_t size, size_t alignment)
+	{
+		auto* f = alloc_finalizer();
+		auto* block = (large_block*)alloc(sizeof(large_block), alignof(large_block));
+		block->m_Allocator = this;
+		block->m_Size = size + (alignment > LARGE_BLOCK_ALIGNMENT ? alignment : 0);
+		block->m_Ptr = map_pages(block->m_Size);
+		m_LargeBytes += block->m_Size;
+		push_finalizer(f, block, [](void* p)
+		{
+			auto* block = (large_block*)p;
+			unmap_pages(block->m_Ptr, block->m_Size);
+			block->m_Allocator->m_LargeBytes -= block->m_Size;
+		});
+		return (void*)align_up((uintptr_t)block->m_Ptr, alignment);
+	}
+
 	inline void* page_stack_allocator_base::last_page_ptr()
 	{
 		QAPP_ASSERT(!m_Pages.empty());
@@ -79,8 +153,7 @@ namespace qapp
 	void page_stack_allocator_base::add_page(size_t min_size)
 	{
 		const auto min_size_pow_2 = std::bit_ceil(min_size);
-		if (min_size_pow_2 > m_PagePool.PageSizeMax())
-			throw std::runtime_error("Requested allocation size is larger than max page size");
+		QAPP_ASSERT(min_size_pow_2 <= m_PagePool.PageSizeMax());
 
 		size_t page_size = m_Pages.empty() ?
 			m_PagePool.PageSizeMin() :
@@ -89,12 +162,14 @@ namespace qapp
 		page_size = std::max(min_size_pow_2, page_size);
 
 		m_Pages.push_back(m_PagePool.Alloc((unsigned char)std::countr_zero(page_size)));
+		m_PageBytes += page_size;
 		
 		m_LastPageUsage = 0;
 	}
 
 	void page_stack_allocator_base::pop_page()
 	{
+		m_PageBytes -= m_PagePool.PageSize(m_Pages.back());
 		m_PagePool.Free(m_Pages.back());
 		m_Pages.pop_back();
 		m_LastPageUsage = m_Pages.empty() ? 0 : (unsigned int)m_PagePool.PageSize(m_Pages.back());
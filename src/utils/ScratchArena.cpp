@@ -0,0 +1,79 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include <qapplib/utils/PageAllocator.h>
+#include <qapplib/utils/ScratchArena.h>
+
+namespace qapp
+{
+	static const size_t SCRATCH_PAGE_SIZE_MAX = 1 << 20;
+
+	// Shared by the scratch arenas of all threads. The thread_local arenas of the main thread are destroyed before
+	// this static pool.
+	CPagePool& scratch_page_pool()
+	{
+		static TStdPageAllocator<SCRATCH_PAGE_SIZE_MAX> s_PageAllocator;
+		static CPagePool s_PagePool(s_PageAllocator, 12, CPagePool::EThreading::Concurrent);
+		return s_PagePool;
+	}
+
+	scratch_arena::scratch_arena()
+		: m_Allocator(scratch_page_pool())
+		, m_Memory(m_Allocator)
+	{
+		// Thread-local objects are destroyed in reverse order of construction. Create the pool's cache of this
+		// thread before the arena is complete, so that it is still alive when the arena frees its pages at thread
+		// exit.
+		scratch_page_pool().FlushThreadCache();
+	}
+
+	scratch_arena& scratch_arena::current()
+	{
+		thread_local scratch_arena arena;
+		return arena;
+	}
+
+	scratch_arena_stats scratch_stats()
+	{
+		const auto& arena = scratch_arena::current();
+		scratch_arena_stats stats;
+		stats.m_UsedBytes = arena.m_Allocator.used_bytes();
+		stats.m_PeakUsedBytes = std::max(arena.m_PeakUsedBytes, stats.m_UsedBytes);
+		stats.m_PageBytes = arena.m_Allocator.page_bytes();
+		stats.m_FrameDepth = arena.m_Depth;
+		return stats;
+	}
+
+	scratch_frame::scratch_frame()
+		: m_Arena(scratch_arena::current())
+		, m_State(m_Arena.m_Allocator.state())
+		, m_Depth(++m_Arena.m_Depth)
+	{
+	}
+
+	scratch_frame::~scratch_frame()
+	{
+		QAPP_ASSERT(m_Depth == m_Arena.m_Depth);
+		m_Arena.m_PeakUsedBytes = std::max(m_Arena.m_PeakUsedBytes, m_Arena.m_Allocator.used_bytes());
+		m_Arena.m_Allocator.restore(m_State);
+		--m_Arena.m_Depth;
+	}
+}
\ No newline at end of file
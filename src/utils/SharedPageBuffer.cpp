@@ -0,0 +1,138 @@
+/*
+Copyright XMN Software AB 2023
+
+QAppLib is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version. The GNU Lesser General Public License
+is intended to guarantee your freedom to share and change all versions
+of a program--to make sure it remains free software for all its users.
+
+QAppLib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <qapplib/utils/ByteSearch.h>
+#include <qapplib/utils/SharedPageBuffer.h>
+
+namespace qapp
+{
+	shared_page_buffer_desc export_shared(const page_buffer_snapshot& snapshot, const CFilePageAllocator& allocator)
+	{
+		// Each segment starts a page, the last one ends with the contents
+		shared_page_buffer_desc desc;
+		desc.m_Size = snapshot.size();
+		snapshot.for_each_segment(0, SIZE_MAX, [&](const void* page, size_t size)
+		{
+			desc.m_Pages.push_back({ allocator.FileOffset(page), size });
+		});
+		return desc;
+	}
+
+	void write_shared_desc(std::ostream& out, const shared_page_buffer_desc& desc)
+	{
+		const uint64_t page_count = desc.m_Pages.size();
+		out.write((const char*)&desc.m_Size, sizeof(desc.m_Size));
+		out.write((const char*)&page_count, sizeof(page_count));
+		out.write((const char*)desc.m_Pages.data(), page_count * sizeof(shared_page_buffer_desc::SPage));
+	}
+
+	shared_page_buffer_desc read_shared_desc(std::istream& in)
+	{
+		shared_page_buffer_desc desc;
+		uint64_t page_count = 0;
+		in.read((char*)&desc.m_Size, sizeof(desc.m_Size));
+		in.read((char*)&page_count, sizeof(page_count));
+		if (!in)
+			throw std::runtime_error("Failed to read shared page buffer description");
+		desc.m_Pages.resize(page_count);
+		in.read((char*)desc.m_Pages.data(), page_count * sizeof(shared_page_buffer_desc::SPage));
+		if (in.gcount() != (std::streamsize)(page_count * sizeof(shared_page_buffer_desc::SPage)))
+			throw std::runtime_error("Failed to read shared page buffer description");
+		return desc;
+	}
+
+	shared_page_buffer_view::shared_page_buffer_view(int fd, const shared_page_buffer_desc& desc)
+		: m_Size(desc.m_Size)
+	{
+		struct stat st;
+		if (0 != fstat(fd, &st))
+			throw std::runtime_error("Failed to query shared page file");
+		m_MappingSize = (size_t)st.st_size;
+		for (auto& page : desc.m_Pages)
+		{
+			if (page.m_FileOffset + page.m_Size > m_MappingSize)
+				throw std::runtime_error("Shared page outside of the shared page file");
+		}
+
+		if (m_MappingSize)
+		{
+			auto* ptr = mmap(nullptr, m_MappingSize, PROT_READ, MAP_SHARED, fd, 0);
+			if (MAP_FAILED == ptr)
+				throw std::runtime_error("Failed to map shared page file");
+			m_Mapping = (const char*)ptr;
+		}
+
+		size_t end = 0;
+		for (auto& page : desc.m_Pages)
+		{
+			end += (size_t)page.m_Size;
+			m_PagePtrs.push_back(m_Mapping + page.m_FileOffset);
+			m_PageEnds.push_back(end);
+		}
+		m_Size = std::min(m_Size, end);
+	}
+
+	shared_page_buffer_view::~shared_page_buffer_view()
+	{
+		if (m_Mapping)
+			munmap((void*)m_Mapping, m_MappingSize);
+	}
+
+	size_t shared_page_buffer_view::read(size_t offset, void* buffer, size_t buffer_size) const
+	{
+		char* p = (char*)buffer;
+		for_each_segment(offset, buffer_size, [&](const void* segment, size_t n)
+		{
+			memcpy(p, segment, n);
+			p += n;
+		});
+		return p - (char*)buffer;
+	}
+
+	size_t shared_page_buffer_view::find(uint8_t byte, size_t offset) const
+	{
+		return find_byte_in(*this, offset, byte);
+	}
+
+	size_t shared_page_buffer_view::find(const void* pattern, size_t pattern_size, size_t offset) const
+	{
+		return find_pattern_in(*this, offset, pattern, pattern_size);
+	}
+
+	size_t shared_page_buffer_view::count(uint8_t byte, size_t offset, size_t size) const
+	{
+		return count_byte_in(*this, offset, size, byte);
+	}
+
+	size_t shared_page_buffer_view::page_index_at(size_t offset) const
+	{
+		return (size_t)(std::upper_bound(m_PageEnds.begin(), m_PageEnds.end(), offset) - m_PageEnds.begin());
+	}
+}
+
+#endif
\ No newline at end of file
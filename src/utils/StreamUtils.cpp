@@ -19,11 +19,52 @@ along with QAppLib. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <algorithm>
+#include <bit>
 #include <stdexcept>
+#include <qapplib/utils/ByteSearch.h>
+#include <qapplib/utils/PageAllocator.h>
+#include <qapplib/utils/ScratchArena.h>
 #include <qapplib/utils/StreamUtils.h>
 
 namespace qapp
 {
+	CLineBuffer::CLineBuffer(size_t size)
+		: m_Size(size)
+	{
+		auto& page_pool = scratch_page_pool();
+		if (size > page_pool.PageSizeMax())
+		{
+			m_Data = (char*)map_pages(size);
+			return;
+		}
+		const auto page_size_bits = std::max(page_pool.PageSizeMinBits(), (unsigned char)std::bit_width(size - 1));
+		m_Data = (char*)page_pool.PtrFromHandle(page_pool.Alloc(page_size_bits));
+	}
+
+	CLineBuffer::~CLineBuffer()
+	{
+		auto& page_pool = scratch_page_pool();
+		if (m_Size > page_pool.PageSizeMax())
+		{
+			unmap_pages(m_Data, m_Size);
+			return;
+		}
+		const auto page_size_bits = std::max(page_pool.PageSizeMinBits(), (unsigned char)std::bit_width(m_Size - 1));
+		page_pool.Free(page_pool.HandleFromPtr(m_Data, page_size_bits));
+	}
+
+	std::streamoff imemstream::streambuf::find(const void* pattern, size_t pattern_size) const
+	{
+		auto* p = (const char*)find_pattern(gptr(), egptr() - gptr(), pattern, pattern_size);
+		return p ? p - eback() : -1;
+	}
+
+	size_t imemstream::streambuf::count(uint8_t byte) const
+	{
+		return count_byte(gptr(), egptr() - gptr(), byte);
+	}
+
 	QVariant readVariant(std::istream& in)
 	{
 		const auto type = (QVariant::Type)tread<uint16_t>(in);